@@ -12,30 +12,107 @@
 #include <model.h>
 
 #include <math.h>
+#include <cstring>
+#include <cstdlib>
 #include <iostream>
 #include <figureset.h>
+#include <renderqueue.h>
+#include <framestats.h>
+#include <bounds.h>
+#include <bvh.h>
+#include <occlusion.h>
+#include <gputimer.h>
+#include <lights.h>
+#include <deferred.h>
+#include <clustered.h>
+#include <shadows.h>
+#include <shadercache.h>
+#include <shadercompiler.h>
+#include <transforms.h>
+#include <scenegraph.h>
+#include <entities.h>
+#include <jobs.h>
+#include <framesnapshot.h>
+#include <resolution.h>
+#include <postprocess.h>
+#include <framepacer.h>
+#include <streambuffer.h>
+#include <hall.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
     
 // Functions definitions 
 void UpdateShaderMatrixes(Shader& shader);
+glm::mat4 GetProjectionMatrix();
 void FramebufferSizeCallback(GLFWwindow* window, int width, int height);
 void MouseCallback(GLFWwindow* window, double xpos, double ypos);
 void ScrollCallback(GLFWwindow* window, double xoffset, double yoffset);
-void ProcessInput(GLFWwindow* window);
-void UpdateLightningShaderSettings(Shader& shader);
-void UpdateShaderMatrixes(Shader& shader);
+void WindowRefreshCallback(GLFWwindow* window);
+void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
+void ProcessInput(GLFWwindow* window, float time);
+void UpdateLightningShaderSettings(Shader& shader, const FrameSnapshot& frame);
+void UpdateShaderMatrixes(Shader& shader, const FrameSnapshot& frame);
+void BuildSceneLights(LightList& lights, const FrameSnapshot& frame);
+glm::vec3 GetSpotlightDirection();
+unsigned int GetShaderFeatures();
+void BuildFrameSnapshot(FrameSnapshot& frame, float time);
+void PublishFrameSnapshot();
+void ParseArguments(int argc, char* argv[]);
+void UpdateStatsConfig(const FrameSnapshot& frame);
 
 
 // Settings
 const unsigned int SCR_WIDTH = 1000;
 const unsigned int SCR_HEIGHT = 750;
 
+const float NEAR_PLANE = 0.1f;
+const float FAR_PLANE  = 100.0f;
+// pushed out by the tournament hall, so the camera sees across it
+float farPlane = FAR_PLANE;
+
 const float LAMP_SCALE  = 0.008f;
 
 const float SPOTLIGHT_HEIGHT            = 1.5f;
 const float SPOTLIGHT_FULL_TURN_TIME_S  = 12.0f;
 const float SPOTLIGHT_MOVEMENT_RADIUS   = 5.0f;
 
+// frames still drawn after the last change in on-demand mode, occlusion results and timers lag behind
+const int    ON_DEMAND_SETTLE_FRAMES = 3;
+// longest sleep of an idle main thread, so time limits like the benchmark end are still noticed
+const double ON_DEMAND_IDLE_TIMEOUT_S = 0.5;
+// longest step simulated on the first frame after idling, a key pressed after a pause must not jump the camera
+const float  ON_DEMAND_WAKE_STEP_S = 1.0f / 30.0f;
+
+const int   VENUE_LAMP_COUNT  = 48;
+const float VENUE_LAMP_RADIUS = 7.0f;
+const float VENUE_LAMP_HEIGHT = 2.5f;
+
+const int SHADING_PHONG    = 0;
+const int SHADING_GOURAUD  = 1;
+const int SHADING_DEFERRED = 2;
+const int SHADING_CLUSTERED = 3;
+// the plain forward path with the fallback program, while the real one is still compiling
+const int SHADING_FALLBACK  = -1;
+
+// sources of the lighting shader of every shading mode and the features it can be specialized for
+struct ShadingProgram {
+    const char* vertexPath;
+    const char* fragmentPath;
+    unsigned int features;
+};
+const ShadingProgram SHADING_PROGRAMS[] = {
+    { "../Shaders/phong_lighting_shader.vert", "../Shaders/phong_lighting_shader.frag", FEATURE_BLINN | FEATURE_SPOTLIGHT | FEATURE_SHADOWS }, // id = 0
+    { "../Shaders/gouraud_lighting_shader.vert", "../Shaders/gouraud_lighting_shader.frag", FEATURE_BLINN | FEATURE_SPOTLIGHT },            // id = 1
+    { "../Shaders/phong_lighting_shader.vert", "../Shaders/gbuffer_shader.frag", 0 },                                                                  // id = 2
+    { "../Shaders/phong_lighting_shader.vert", "../Shaders/clustered_lighting_shader.frag", FEATURE_BLINN }                               // id = 3
+};
+const ShadingProgram LAMP_PROGRAM = { "../Shaders/lamp_shader.vert", "../Shaders/lamp_shader.frag", 0 };
+// the distant boards of the tournament hall
+const ShadingProgram IMPOSTOR_PROGRAM = { "../Shaders/impostor.vert", "../Shaders/impostor.frag", FEATURE_BLINN | FEATURE_SPOTLIGHT };
+
 
 float lastCameraChangeTime = 0;
 int currentCameraIndex = 0;
@@ -48,7 +125,7 @@ Camera* cameras[] = {
     &stableCamera     // id = 2
 };
 
-glm::vec3 lampPos(0, 4, 0);
+glm::vec3 lampPos(0, 4, 0); // relative to the board center
 float lampBrightnessLevel = 9; // scale: 0 - 9
 
 float lastX = SCR_WIDTH / 2.0f;
@@ -58,6 +135,10 @@ bool firstMouse = true;
 bool spotlightLightIsActive = false;
 float spotlightAngle = -30.0f;
 float lastSpotlightChangeTime = 0;
+// the rig orbits while this is on, the orbit only advances with it
+bool spotlightIsOrbiting = true;
+float spotlightOrbitTime = 0;
+float lastOrbitChangeTime = 0;
 
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
@@ -69,9 +150,89 @@ bool useBlinn = true;
 float lastFogChangeTime = 0;
 int fogLevel = 0;
 
+RenderQueue renderQueue;
+SceneBVH sceneBVH;
+FrameStats frameStats;
+bool printFrameStats = false;
+float lastStatsChangeTime = 0;
+// bumped by every toggle of a setting printed with the statistics
+unsigned int settingsVersion = 1;
+bool useOcclusionCulling = true;
+float lastOcclusionChangeTime = 0;
+
+// depth-only pre-pass followed by GL_EQUAL shading, pays off when fragment shading dominates
+bool useDepthPrepass = false;
+float lastDepthPrepassChangeTime = 0;
+
+// extra ring of lamps around the board, lit only by the deferred and clustered paths
+bool venueLampsAreActive = false;
+float lastVenueLampsChangeTime = 0;
+LightList sceneLights;
+
+// shadows of the lamp and the spotlight in Phong shading mode
+bool useShadows = true;
+float lastShadowsChangeTime = 0;
+// --shadow-size <pixels>: resolution of the spotlight map, it is re-rendered every frame
+int spotlightShadowSize = SPOTLIGHT_SHADOW_SIZE;
+
+// scene graph nodes the lights and the spotlight camera are placed by
+unsigned int boardNode = SCENE_ROOT;
+unsigned int lampNode = SCENE_ROOT;
+unsigned int spotlightRigNode = SCENE_ROOT;
+
+// fixed once the scene is loaded, the spotlight orbits it and aims at it
+glm::vec3 boardCenter(0.0f);
+
+// last size reported by GLFW, the frame snapshots carry it to the render thread
+int framebufferWidth = SCR_WIDTH;
+int framebufferHeight = SCR_HEIGHT;
+
+// --no-render-thread: input, simulation and drawing all on the main thread, for comparison
+bool useRenderThread = true;
+// the main thread publishes a snapshot per simulated frame, the render thread draws the newest one
+TripleBuffer<FrameSnapshot> frameSnapshots;
+// the render thread sleeps on this while no new snapshot was published
+mutex snapshotMutex;
+condition_variable snapshotPublished;
+
+// --on-demand: a frame is only drawn when it would look different from the last one
+bool renderOnDemand = false;
+// the window contents were lost, set by the refresh callback
+bool windowDamaged = false;
+// a key event arrived since the last frame and the keys held down, set by the key callback
+bool keyEventReceived = false;
+int keysHeld = 0;
+
+// programs were still compiling in the background at the last check
+std::atomic<bool> shadersPending(true);
+
+// --jobs <workers>: size of the job system pool, by default one worker per core next to the GL thread
+int jobWorkers = -1;
 
-int main()
+// --hall <boards>: tournament hall stress scene, the main board and copies of it around it
+unsigned int hallBoards = 1;
+
+// FXAA post-process pass over the finished scene
+bool useAntialiasing = false;
+float lastAntialiasingChangeTime = 0;
+
+// --frame-budget <ms>: GPU time the scene may take, the render resolution follows it
+float frameBudgetMs = 0.0f;
+
+// --just-in-time: the input is sampled shortly before the vertical blank instead of right after the last frame
+float lastJustInTimeChangeTime = 0;
+
+// --benchmark <seconds>: flies the automatic camera, prints statistics and a summary, then exits
+float benchmarkDuration = 0.0f;
+
+
+int main(int argc, char* argv[])
 {
+    ParseArguments(argc, argv);
+    if (jobWorkers < 0)
+        jobWorkers = std::max(0, (int)std::thread::hardware_concurrency() - 1);
+    jobSystem.Init(jobWorkers);
+
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -85,141 +246,561 @@ int main()
         return -1;
     }
     glfwMakeContextCurrent(window);
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
     glfwSetFramebufferSizeCallback(window, FramebufferSizeCallback);
     glfwSetCursorPosCallback(window, MouseCallback);
     glfwSetScrollCallback(window, ScrollCallback);
+    glfwSetWindowRefreshCallback(window, WindowRefreshCallback);
+    glfwSetKeyCallback(window, KeyCallback);
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    framePacer.Init();
 
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
     {
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    programBinaryCache.Init((GLADloadproc)glfwGetProcAddress, "../ShaderCache/");
+    streamBuffer.Init((GLADloadproc)glfwGetProcAddress);
 
-    glEnable(GL_DEPTH_TEST);
+    glState.Enable(GL_DEPTH_TEST);
 
+    float loadStart = (float)glfwGetTime();
     Figureset figureset("../Models/");
     figureset.LoadFigures();
+    if (benchmarkDuration > 0)
+        std::cout << "STARTUP::MODELS ms: " << 1000.0f * ((float)glfwGetTime() - loadStart)
+            << " job workers: " << jobSystem.WorkerCount() << std::endl;
 
-    Shader phongShader("../Shaders/phong_lighting_shader.vert", "../Shaders/phong_lighting_shader.frag");
-    Shader gouraudShader("../Shaders/gouraud_lighting_shader.vert", "../Shaders/gouraud_lighting_shader.frag");
-    Shader lampShader("../Shaders/lamp_shader.vert", "../Shaders/lamp_shader.frag");
-    Shader spotlightShader("../Shaders/lamp_shader.vert", "../Shaders/lamp_shader.frag");
+    // every specialization is compiled in the background, toggling features only switches programs.
+    // The variants needed right now are requested first, the fallback is drawn until they are ready.
+    float shaderBuildStart = (float)glfwGetTime();
+    ShaderCompiler shaderCompiler;
+    shaderCompiler.Init(window);
+    Shader fallbackShader("../Shaders/fallback_shader.vert", "../Shaders/fallback_shader.frag");
+    ShaderCache shaderCache(&shaderCompiler);
+    shaderCache.Get(SHADING_PROGRAMS[currentShaderIndex].vertexPath, SHADING_PROGRAMS[currentShaderIndex].fragmentPath, GetShaderFeatures() & SHADING_PROGRAMS[currentShaderIndex].features);
+    shaderCache.Get(LAMP_PROGRAM.vertexPath, LAMP_PROGRAM.fragmentPath, GetShaderFeatures() & LAMP_PROGRAM.features);
+    for (const ShadingProgram& program : SHADING_PROGRAMS)
+        shaderCache.Prebuild(program.vertexPath, program.fragmentPath, program.features);
+    shaderCache.Prebuild(LAMP_PROGRAM.vertexPath, LAMP_PROGRAM.fragmentPath, LAMP_PROGRAM.features);
+    const char* compileModeNames[] = { "synchronous", "parallel extension", "worker thread" };
+    if (benchmarkDuration > 0)
+        std::cout << "STARTUP::SHADERS programs: " << shaderCache.Size()
+            << " ms: " << 1000.0f * ((float)glfwGetTime() - shaderBuildStart)
+            << " compile: " << compileModeNames[shaderCompiler.Mode]
+            << " binary cache: " << (programBinaryCache.Available() ? "on" : "off")
+            << " hits: " << programBinaryCache.stats.hits
+            << " misses: " << programBinaryCache.stats.misses
+            << " rejected: " << programBinaryCache.stats.rejected << std::endl;
 
+    Shader depthPrepassShader("../Shaders/depth_prepass_shader.vert", "../Shaders/depth_prepass_shader.frag");
+    DeferredRenderer deferredRenderer("../Shaders/");
+    ClusteredLighting clusteredLighting;
+    ShadowMaps shadowMaps("../Shaders/", spotlightShadowSize);
+    PostProcess postProcess("../Shaders/");
+    DynamicResolution dynamicResolution;
+    dynamicResolution.Enabled = frameBudgetMs > 0;
+    dynamicResolution.BudgetMs = frameBudgetMs;
 
-    Shader* shaders[] = {
-        &phongShader,   // id = 0
-        &gouraudShader  // id = 1
-    };
-
-    Model spotlight(
+    unsigned int spotlight = sceneEntities.AddModel(Model(
         "../Models/spotlight/spotlight.obj",
-        STARTING_POS + glm::vec3(0.0f, 1.0f, 0.0f),
+        glm::vec3(0.0f, 1.0f, 0.0f),
         0.01f,
         glm::vec3(90, 0, -90)
-    );
-    Model spotlightLight(
+    ));
+    unsigned int spotlightLight = sceneEntities.AddModel(Model(
         "../Models/spotlight/spotlightLight.obj",
-        STARTING_POS + glm::vec3(0.0f, 1.0f, 0.0f),
+        glm::vec3(0.0f, 1.0f, 0.0f),
         0.01f,
         glm::vec3(90, 0, -90)
-    );
+    ));
     
-    Model lamp(
+    unsigned int lamp = sceneEntities.AddModel(Model(
         "../Models/lamp/lamp.obj",
-        STARTING_POS + glm::vec3(0.0f, 0.0f, 0.0f),
+        glm::vec3(0.0f, 0.0f, 0.0f),
         LAMP_SCALE
-    );
-    Model lampLight(
+    ));
+    unsigned int lampLight = sceneEntities.AddModel(Model(
         "../Models/lamp/lampLight.obj",
-        STARTING_POS + glm::vec3(0.0f, 0.0f, 0.0f),
+        glm::vec3(0.0f, 0.0f, 0.0f),
         LAMP_SCALE
-    );
+    ));
 
-    while (!glfwWindowShouldClose(window))
+    // the lamp and the spotlight rig stand on the board, the rig orbits it and carries both spotlight models
+    boardNode = figureset.boardNode;
+    lampNode = sceneGraph.AddNode(boardNode, lampPos);
+    sceneEntities.Spawn(lamp, lampNode);
+    unsigned int lampLightEntity = sceneEntities.Spawn(lampLight, lampNode, PASS_EMISSIVE);
+    spotlightRigNode = sceneGraph.AddNode(boardNode, glm::vec3(0.0f));
+    unsigned int spotlightEntity = sceneEntities.Spawn(spotlight, spotlightRigNode);
+    unsigned int spotlightLightEntity = sceneEntities.Spawn(spotlightLight, spotlightRigNode, PASS_EMISSIVE);
+    sceneGraph.Update();
+    sceneEntities.RegisterBounds(sceneBVH);
+    boardCenter = sceneGraph.WorldPosition(boardNode);
+
+    // the hall boards are drawn with instanced variants of the lighting programs and of the depth pre-pass
+    Shader* depthPrepassInstancedShader = nullptr;
+    if (hallBoards > 1)
     {
-        float currentFrame = glfwGetTime();
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
+        tournamentHall.Build(figureset, hallBoards, "../Shaders/");
+        depthPrepassInstancedShader = &shaderCache.Get("../Shaders/depth_prepass_shader.vert", "../Shaders/depth_prepass_shader.frag", FEATURE_INSTANCED);
+        farPlane = std::max(FAR_PLANE, 2.0f * tournamentHall.Extent());
+        for (const ShadingProgram& program : SHADING_PROGRAMS)
+            shaderCache.Prebuild(program.vertexPath, program.fragmentPath, program.features | FEATURE_INSTANCED);
+        if (tournamentHall.Impostors)
+            shaderCache.Prebuild(IMPOSTOR_PROGRAM.vertexPath, IMPOSTOR_PROGRAM.fragmentPath, IMPOSTOR_PROGRAM.features);
+        std::cout << "HALL::BUILD boards: " << tournamentHall.Size() + 1 << " far plane: " << farPlane << std::endl;
+    }
+
+    // back-rank pieces hide behind pawns at low camera angles, the board and the pieces occlude them
+    OcclusionCuller occlusionCuller("../Shaders/bounds_shader.vert", "../Shaders/bounds_shader.frag");
+    vector<unsigned int> pieceObjectIds;
+    sceneEntities.GetObjectIds(pieceObjectIds, ENTITY_OCCLUDEE);
+    for (unsigned int id : pieceObjectIds)
+        occlusionCuller.AddOccludee(id);
+
+    GpuTimer shadowTimer;
+    GpuTimer depthPrepassTimer;
+    GpuTimer shadingTimer;
+    GpuTimer impostorTimer;
+    int viewportWidth = framebufferWidth;
+    int viewportHeight = framebufferHeight;
+    unsigned int statsSettingsVersion = 0;
+    float lastPresentTime = (float)glfwGetTime();
 
-        ProcessInput(window);
+    // draws one snapshot on the thread owning the GL context, scene graph, entities and queues
+    // are only touched here once the render loop runs
+    auto renderFrame = [&](const FrameSnapshot& frame)
+    {
+        if (frame.framebufferWidth != viewportWidth || frame.framebufferHeight != viewportHeight)
+        {
+            viewportWidth = frame.framebufferWidth;
+            viewportHeight = frame.framebufferHeight;
+            glViewport(0, 0, viewportWidth, viewportHeight);
+        }
+        if (frame.settingsVersion != statsSettingsVersion)
+        {
+            statsSettingsVersion = frame.settingsVersion;
+            UpdateStatsConfig(frame);
+        }
+        frameStats.Enabled = frame.printStats;
+
+        // per draw data of this frame goes into the region the GPU finished reading three frames ago
+        streamBuffer.BeginFrame();
+        if (streamBuffer.Persistent())
+            frameStats.AddTiming("stream wait", streamBuffer.WaitMs());
+
+        shaderCompiler.Poll();
+        if (shadersPending && shaderCompiler.Pending() == 0)
+        {
+            shadersPending = false;
+            if (benchmarkDuration > 0)
+                std::cout << "STARTUP::SHADERS all programs ready after ms: " << 1000.0f * ((float)glfwGetTime() - shaderBuildStart) << std::endl;
+        }
+
+        // with post-processing the scene goes into an offscreen target, at the resolution the scaler picked
+        int sceneWidth = dynamicResolution.SceneSize(frame.framebufferWidth);
+        int sceneHeight = dynamicResolution.SceneSize(frame.framebufferHeight);
+        float sceneGpuMs = 0.0f;
+        bool postProcessing = dynamicResolution.Enabled || frame.antialiasing || frame.fogLevel > 0;
+        if (postProcessing)
+            postProcess.Begin(frame.framebufferWidth, frame.framebufferHeight, sceneWidth, sceneHeight);
 
         glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        float time = (float)glfwGetTime();
-        float angle = (time / SPOTLIGHT_FULL_TURN_TIME_S) * 2 * MATH_PI;
-        spotlightCamera.Position = STARTING_POS + glm::vec3(std::cos(angle) * SPOTLIGHT_MOVEMENT_RADIUS,
-                                                   SPOTLIGHT_HEIGHT,
-                                                   std::sin(angle) * SPOTLIGHT_MOVEMENT_RADIUS);
-        spotlightCamera.Front = STARTING_POS - spotlightCamera.Position;
-
-        UpdateShaderMatrixes(lampShader);
-        lampShader.SetFloat("brightnessLevel", lampBrightnessLevel / 9);
-        lampLight.Draw(lampShader, lampPos);
-
-        UpdateShaderMatrixes(spotlightShader);
-        lampShader.SetFloat("brightnessLevel", 1);
-        if (spotlightLightIsActive) {
-            spotlightLight.Draw(spotlightShader,
-                glm::vec3(std::cos(angle) * SPOTLIGHT_MOVEMENT_RADIUS,
-                    SPOTLIGHT_HEIGHT,
-                    std::sin(angle) * SPOTLIGHT_MOVEMENT_RADIUS),
-                glm::vec3(spotlightAngle, 0, glm::degrees(angle)));
+        sceneGraph.SetPosition(spotlightRigNode, frame.spotlightOffset);
+        sceneGraph.SetRotation(sceneEntities.Node(spotlightEntity), sceneEntities.GetModel(spotlight).GetRotation(frame.spotlightRotation));
+        sceneGraph.SetRotation(sceneEntities.Node(spotlightLightEntity), sceneEntities.GetModel(spotlightLight).GetRotation(frame.spotlightRotation));
+        sceneGraph.Update();
+
+        const ShadingProgram& shadingProgram = SHADING_PROGRAMS[frame.shading];
+        Shader& lightingShader = shaderCache.GetReady(shadingProgram.vertexPath, shadingProgram.fragmentPath, frame.shaderFeatures & shadingProgram.features, fallbackShader);
+        // the lamp and the spotlight bulb share one program, their brightness is set per draw
+        Shader& lampShader = shaderCache.GetReady(LAMP_PROGRAM.vertexPath, LAMP_PROGRAM.fragmentPath, frame.shaderFeatures & LAMP_PROGRAM.features, fallbackShader);
+        int activeShading = &lightingShader != &fallbackShader ? frame.shading : SHADING_FALLBACK;
+
+        UpdateShaderMatrixes(lampShader, frame);
+
+        UpdateShaderMatrixes(lightingShader, frame);
+        UpdateLightningShaderSettings(lightingShader, frame);
+
+        // only what the scene graph moved gets new bounds
+        sceneEntities.UpdateBounds(sceneBVH);
+        sceneEntities.SetBrightness(lampLightEntity, frame.lampBrightness);
+        sceneEntities.SetEnabled(spotlightLightEntity, frame.spotlightActive);
+
+        const glm::mat4& projection = frame.projection;
+        const glm::mat4& view = frame.view;
+        Frustum frustum(projection * view);
+        sceneBVH.Cull(frustum);
+        occlusionCuller.Enabled = frame.occlusionCulling;
+        occlusionCuller.Apply(sceneBVH, frame.viewPosition);
+
+        renderQueue.Begin(frame.viewPosition);
+
+        sceneEntities.Submit(renderQueue, lightingShader, lampShader, sceneBVH, frustum);
+
+        // the hall waits for its instanced variants and impostor program, skipping it is cheaper than
+        // drawing it with the fallback
+        Shader* hallShader = nullptr;
+        Shader* impostorShader = nullptr;
+        bool depthPrepassActive = frame.depthPrepass && activeShading != SHADING_DEFERRED;
+        if (tournamentHall.Size() > 0 && activeShading != SHADING_FALLBACK && (!depthPrepassActive || depthPrepassInstancedShader->Ready()))
+        {
+            Shader& shader = shaderCache.GetReady(shadingProgram.vertexPath, shadingProgram.fragmentPath,
+                (frame.shaderFeatures & shadingProgram.features) | FEATURE_INSTANCED, fallbackShader);
+            Shader& impostor = tournamentHall.Impostors ? shaderCache.GetReady(IMPOSTOR_PROGRAM.vertexPath, IMPOSTOR_PROGRAM.fragmentPath,
+                frame.shaderFeatures & IMPOSTOR_PROGRAM.features, fallbackShader) : shader;
+            if (&shader != &fallbackShader && &impostor != &fallbackShader)
+            {
+                hallShader = &shader;
+                UpdateShaderMatrixes(shader, frame);
+                UpdateLightningShaderSettings(shader, frame);
+                if (tournamentHall.Impostors)
+                {
+                    impostorShader = &impostor;
+                    UpdateShaderMatrixes(impostor, frame);
+                    UpdateLightningShaderSettings(impostor, frame);
+                }
+                float hallStart = (float)glfwGetTime();
+                tournamentHall.Submit(renderQueue, shader, frustum);
+                frameStats.AddTiming("hall", 1000.0f * ((float)glfwGetTime() - hallStart));
+            }
         }
 
-        UpdateShaderMatrixes(*shaders[currentShaderIndex]);
-        UpdateLightningShaderSettings(*shaders[currentShaderIndex]);
+        renderQueue.Sort();
+        if (activeShading == SHADING_CLUSTERED)
+        {
+            BuildSceneLights(sceneLights, frame);
 
+            float assignmentStart = (float)glfwGetTime();
+            clusteredLighting.Update(sceneLights, projection, view, NEAR_PLANE, farPlane);
+            frameStats.AddTiming("light assignment", 1000.0f * ((float)glfwGetTime() - assignmentStart));
+            clusteredLighting.Bind(lightingShader, sceneWidth, sceneHeight);
+            if (hallShader != nullptr)
+                clusteredLighting.Bind(*hallShader, sceneWidth, sceneHeight);
+        }
 
-        lamp.Draw(*shaders[currentShaderIndex], lampPos);
-        spotlight.Draw(*shaders[currentShaderIndex],
-            glm::vec3(std::cos(angle) * SPOTLIGHT_MOVEMENT_RADIUS,
-                SPOTLIGHT_HEIGHT,
-                std::sin(angle) * SPOTLIGHT_MOVEMENT_RADIUS),
-            glm::vec3(spotlightAngle, 0, glm::degrees(angle)));
+        if (activeShading == SHADING_PHONG && frame.shadows)
+        {
+            // the lamp map is cached and normally costs nothing, the spotlight map is redrawn every frame
+            shadowTimer.Begin();
+            shadowMaps.UpdateLamp(sceneEntities, sceneGraph.WorldPosition(lampNode));
+            if (frame.spotlightActive)
+                shadowMaps.UpdateSpotlight(sceneEntities, frame.spotlightPosition, frame.spotlightDirection, glm::cos(glm::radians(40.0f)));
+            shadowTimer.End();
+            frameStats.AddTiming("shadows", shadowTimer.LastMs());
+            sceneGpuMs += shadowTimer.LastMs();
+            shadowMaps.Bind(lightingShader);
+            // the hall boards receive the shadows of the main board but cast none
+            if (hallShader != nullptr)
+                shadowMaps.Bind(*hallShader);
+        }
 
-        figureset.Draw(*shaders[currentShaderIndex]);
+        if (activeShading == SHADING_DEFERRED)
+        {
+            deferredRenderer.Resize(frame.framebufferWidth, frame.framebufferHeight, sceneWidth, sceneHeight);
+            BuildSceneLights(sceneLights, frame);
 
+            shadingTimer.Begin();
+            deferredRenderer.GeometryPass(renderQueue);
+            deferredRenderer.LightingPass(sceneLights, projection, view, frame.viewPosition, frame.blinn);
+            renderQueue.Execute(PASS_EMISSIVE, PASS_EMISSIVE);
+            shadingTimer.End();
+        }
+        else if (frame.depthPrepass)
+        {
+            depthPrepassTimer.Begin();
+            glState.ColorMask(false);
+            UpdateShaderMatrixes(depthPrepassShader, frame);
+            if (hallShader != nullptr)
+                UpdateShaderMatrixes(*depthPrepassInstancedShader, frame);
+            renderQueue.ExecuteDepthOnly(depthPrepassShader, PASS_OPAQUE, depthPrepassInstancedShader);
+            glState.ColorMask(true);
+            depthPrepassTimer.End();
+
+            // every visible opaque fragment is known now, shade exactly those once
+            shadingTimer.Begin();
+            glState.DepthFunc(GL_EQUAL);
+            glState.DepthMask(false);
+            renderQueue.Execute(PASS_OPAQUE, PASS_OPAQUE);
+            glState.DepthFunc(GL_LESS);
+            glState.DepthMask(true);
+            renderQueue.Execute(PASS_EMISSIVE, PASS_EMISSIVE);
+            shadingTimer.End();
+
+            frameStats.AddTiming("depth prepass", depthPrepassTimer.LastMs());
+            sceneGpuMs += depthPrepassTimer.LastMs();
+        }
+        else
+        {
+            shadingTimer.Begin();
+            renderQueue.Execute();
+            shadingTimer.End();
+        }
+        if (impostorShader != nullptr)
+        {
+            // mostly fill, in a large hall the bigger part of the scene, so the resolution scaler counts it
+            impostorTimer.Begin();
+            tournamentHall.DrawImpostors(renderQueue, *impostorShader);
+            impostorTimer.End();
+            frameStats.AddTiming("impostors", impostorTimer.LastMs());
+            sceneGpuMs += impostorTimer.LastMs();
+        }
+        frameStats.AddTiming("shading", shadingTimer.LastMs());
+        sceneGpuMs += shadingTimer.LastMs();
+        occlusionCuller.IssueQueries(sceneBVH, projection, view);
+
+        if (postProcessing)
+        {
+            postProcess.Antialiasing = frame.antialiasing;
+            postProcess.FogLevel = frame.fogLevel;
+            postProcess.SetCamera(projection, view, frame.viewPosition);
+            postProcess.End(dynamicResolution.Sharpness());
+            if (frame.fogLevel > 0)
+                frameStats.AddTiming("fog", postProcess.FogMs());
+            if (frame.antialiasing)
+                frameStats.AddTiming("fxaa", postProcess.AntialiasingMs());
+        }
+        dynamicResolution.Adapt(sceneGpuMs);
+        streamBuffer.EndFrame();
+
+        // a frame paced just in time waits for the GPU before the swap and for the blank after it, so
+        // the driver queues nothing and the wait in between is the slack the pacer was left with
+        float readyTime = 0.0f;
+        if (frame.targetPresent > 0)
+        {
+            glFinish();
+            readyTime = (float)glfwGetTime();
+        }
         glfwSwapBuffers(window);
+        if (frame.targetPresent > 0)
+            glFinish();
+
+        // latency from sampling the input to handing the frame over, pacing from the intervals between presents
+        float presentTime = (float)glfwGetTime();
+        framePacer.Presented(frame.targetPresent, readyTime, presentTime);
+        frameStats.AddTiming("input latency", 1000.0f * (presentTime - frame.time));
+        if (frame.targetPresent > 0)
+            frameStats.AddTiming("vblank slack", 1000.0f * (presentTime - readyTime));
+        frameStats.AddFrame(presentTime - lastPresentTime, renderQueue.stats, glState.stats, sceneBVH.stats);
+        frameStats.Report(presentTime);
+        glState.ResetStats();
+        lastPresentTime = presentTime;
+    };
+
+    // from here on the render thread owns the GL context, the main thread polls the input and simulates
+    atomic<bool> rendering(true);
+    std::thread renderThread;
+    if (useRenderThread)
+    {
+        glfwMakeContextCurrent(NULL);
+        renderThread = std::thread([&]() {
+            glfwMakeContextCurrent(window);
+            while (rendering)
+            {
+                if (!frameSnapshots.Acquire())
+                {
+                    // sleeps until the next snapshot, an idle scene costs no CPU time
+                    unique_lock<mutex> lock(snapshotMutex);
+                    snapshotPublished.wait(lock, [&] { return !rendering || frameSnapshots.HasNew(); });
+                    continue;
+                }
+                // wakes the main thread, the next snapshot is simulated while this one is drawn
+                glfwPostEmptyEvent();
+                renderFrame(frameSnapshots.Front());
+            }
+            glfwMakeContextCurrent(NULL);
+        });
+    }
+
+    glfwPollEvents();
+    FrameSnapshot lastPublished;
+    int settleFrames = 0;
+    bool idle = false;
+    while (!glfwWindowShouldClose(window))
+    {
+        // the pacer picks when the input of this frame is sampled, events are handled while it waits
+        float targetPresent = 0.0f;
+        framePacer.WaitUntil(framePacer.NextSample(glfwGetTime(), targetPresent));
         glfwPollEvents();
+
+        float currentFrame = glfwGetTime();
+        // time spent idle is not simulated, the first frame after it only advances a short step
+        deltaTime = currentFrame - lastFrame;
+        if (idle)
+            deltaTime = std::min(deltaTime, ON_DEMAND_WAKE_STEP_S);
+        lastFrame = currentFrame;
+
+        ProcessInput(window, currentFrame);
+        FrameSnapshot& frame = frameSnapshots.Back();
+        BuildFrameSnapshot(frame, currentFrame);
+        frame.targetPresent = targetPresent;
+
+        // on demand, camera motion, toggles and animations show up as a different snapshot,
+        // streamed shaders and lost window contents need a redraw of the same one. Held keys and
+        // the orbit keep drawing too, they change the snapshot only as time is simulated.
+        bool draw = true;
+        if (renderOnDemand)
+        {
+            if (!frame.SameImage(lastPublished) || shadersPending || windowDamaged
+                || keyEventReceived || keysHeld > 0 || spotlightIsOrbiting)
+                settleFrames = ON_DEMAND_SETTLE_FRAMES;
+            windowDamaged = false;
+            keyEventReceived = false;
+            draw = settleFrames > 0;
+            if (draw)
+                settleFrames--;
+        }
+        if (draw)
+        {
+            lastPublished = frame;
+            PublishFrameSnapshot();
+        }
+        idle = !draw;
+
+        if (benchmarkDuration > 0 && currentFrame >= benchmarkDuration)
+            glfwSetWindowShouldClose(window, true);
+
+        if (useRenderThread)
+        {
+            // a drawn frame wakes this thread when the render thread takes it, an idle one sleeps
+            if (draw)
+                glfwWaitEvents();
+            else
+                glfwWaitEventsTimeout(ON_DEMAND_IDLE_TIMEOUT_S);
+        }
+        else
+        {
+            if (draw)
+            {
+                frameSnapshots.Acquire();
+                renderFrame(frameSnapshots.Front());
+            }
+            else
+                glfwWaitEventsTimeout(ON_DEMAND_IDLE_TIMEOUT_S);
+        }
     }
 
+    rendering = false;
+    {
+        lock_guard<mutex> lock(snapshotMutex);
+    }
+    snapshotPublished.notify_all();
+    if (renderThread.joinable())
+    {
+        renderThread.join();
+        glfwMakeContextCurrent(window);
+    }
+
+    if (benchmarkDuration > 0)
+        frameStats.PrintSummary();
+
+    shaderCompiler.Shutdown();
+    jobSystem.Shutdown();
     glfwTerminate();
     return 0;
 }
 
-void UpdateShaderMatrixes(Shader& shader) {
-    shader.Use();
-    glm::mat4 projection = glm::perspective(glm::radians(movingCamera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-    glm::mat4 view = cameras[currentCameraIndex]->GetViewMatrix();
+void ParseArguments(int argc, char* argv[]) {
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--benchmark") == 0 && i + 1 < argc) {
+            benchmarkDuration = (float)std::atof(argv[++i]);
+            printFrameStats = true;
+            currentCameraIndex = 0;
+        }
+        else if (std::strcmp(argv[i], "--depth-prepass") == 0)
+            useDepthPrepass = true;
+        else if (std::strcmp(argv[i], "--no-shader-cache") == 0)
+            programBinaryCache.Enabled = false;
+        else if (std::strcmp(argv[i], "--no-persistent-buffers") == 0)
+            streamBuffer.PersistentMapping = false;
+        else if (std::strcmp(argv[i], "--shadow-size") == 0 && i + 1 < argc)
+            spotlightShadowSize = std::max(64, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--jobs") == 0 && i + 1 < argc)
+            jobWorkers = std::max(0, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--fxaa") == 0)
+            useAntialiasing = true;
+        else if (std::strcmp(argv[i], "--frame-budget") == 0 && i + 1 < argc)
+            frameBudgetMs = std::max(0.0f, (float)std::atof(argv[++i]));
+        else if (std::strcmp(argv[i], "--on-demand") == 0)
+        {
+            // a running orbit changes every frame, so the scene starts still and T starts the orbit
+            renderOnDemand = true;
+            spotlightIsOrbiting = false;
+        }
+        else if (std::strcmp(argv[i], "--no-render-thread") == 0)
+            useRenderThread = false;
+        else if (std::strcmp(argv[i], "--no-vsync") == 0)
+            framePacer.VSync = false;
+        else if (std::strcmp(argv[i], "--fps") == 0 && i + 1 < argc)
+            framePacer.TargetFps = std::max(0.0f, (float)std::atof(argv[++i]));
+        else if (std::strcmp(argv[i], "--just-in-time") == 0)
+            framePacer.JustInTime = true;
+        else if (std::strcmp(argv[i], "--hall") == 0 && i + 1 < argc)
+            hallBoards = (unsigned int)std::max(1, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--no-impostors") == 0)
+            tournamentHall.Impostors = false;
+        else
+            std::cout << "Unknown argument: " << argv[i] << std::endl;
+    }
+}
 
-    shader.SetMat4("projection", projection);
-    shader.SetMat4("view", view);
+// settings printed with every statistics line, so reports from different runs can be compared
+void UpdateStatsConfig(const FrameSnapshot& frame) {
+    const char* shadingNames[] = { "phong", "gouraud", "deferred", "clustered" };
+    frameStats.Config = string("shading: ") + shadingNames[frame.shading]
+        + " prepass: " + (frame.depthPrepass && frame.shading != SHADING_DEFERRED ? "on" : "off")
+        + " lights: " + std::to_string(frame.venueLamps ? VENUE_LAMP_COUNT + 2 : 2)
+        + " occlusion: " + (frame.occlusionCulling ? "on" : "off")
+        + " shadows: " + (frame.shadows && frame.shading == SHADING_PHONG ? std::to_string(spotlightShadowSize) : "off")
+        + " render thread: " + (useRenderThread ? "on" : "off")
+        + " resolution: " + (frameBudgetMs > 0 ? "dynamic" : "native")
+        + " aa: " + (frame.antialiasing ? "fxaa" : "off")
+        + " fog: " + std::to_string(frame.fogLevel)
+        + " on demand: " + (renderOnDemand ? "on" : "off")
+        + " vsync: " + (framePacer.VSync ? "on" : "off")
+        + " fps limit: " + (framePacer.TargetFps > 0 ? std::to_string((int)framePacer.TargetFps) : "off")
+        + " input: " + (frame.justInTime ? "just in time" : "frame start")
+        + " draw data: " + (streamBuffer.Persistent() ? "persistent" : "orphaned")
+        + " boards: " + std::to_string(tournamentHall.Size() + 1)
+        + " impostors: " + (tournamentHall.Size() > 0 && tournamentHall.Impostors ? "on" : "off");
+}
 
-    shader.SetVec3("viewPos", cameras[currentCameraIndex]->Position);
-    shader.SetFloat("fogLevel", fogLevel);
+// follows the window, a minimized window keeps the last aspect ratio
+glm::mat4 GetProjectionMatrix() {
+    static float aspect = (float)SCR_WIDTH / (float)SCR_HEIGHT;
+    if (framebufferWidth > 0 && framebufferHeight > 0)
+        aspect = (float)framebufferWidth / (float)framebufferHeight;
+    return glm::perspective(glm::radians(movingCamera.Zoom), aspect, NEAR_PLANE, farPlane);
 }
 
-void UpdateLightningShaderSettings(Shader& shader) {
+void UpdateShaderMatrixes(Shader& shader, const FrameSnapshot& frame) {
+    shader.Use();
+    shader.SetMat4("projection", frame.projection);
+    shader.SetMat4("view", frame.view);
+
+    shader.SetVec3("viewPos", frame.viewPosition);
+}
+
+void UpdateLightningShaderSettings(Shader& shader, const FrameSnapshot& frame) {
     shader.Use();
 
     // lamp light definition
-    shader.SetVec3("lampLight.position", lampPos + STARTING_POS);
+    shader.SetVec3("lampLight.position", sceneGraph.WorldPosition(lampNode));
     shader.SetFloat("lampLight.constant", 1.0f);
     shader.SetFloat("lampLight.linear", 0.004);
     shader.SetFloat("lampLight.quadratic", 0.009);
     shader.SetVec3("lampLight.ambient", 0.2f, 0.2f, 0.2f);
     shader.SetVec3("lampLight.diffuse", 0.9f, 0.9f, 0.9f);
     shader.SetVec3("lampLight.specular", 1.0f, 1.0f, 1.0f);
-    shader.SetFloat("lampLight.brightnessLevel", lampBrightnessLevel / 9);
+    shader.SetFloat("lampLight.brightnessLevel", frame.lampBrightness);
 
     // spotlight light definition
-    float spotlight_aim_h = (spotlightAngle + 45) / 10 - 1.5f;
-    glm::vec3 spotlight_aim = glm::vec3(STARTING_POS.x, spotlight_aim_h, STARTING_POS.z);
-    shader.SetBool("spotlightLight.ON", spotlightLightIsActive);
-    shader.SetVec3("spotlightLight.direction", spotlight_aim - spotlightCamera.Position);
-    shader.SetVec3("spotlightLight.position", spotlightCamera.Position);
+    shader.SetVec3("spotlightLight.direction", frame.spotlightDirection);
+    shader.SetVec3("spotlightLight.position", frame.spotlightPosition);
     shader.SetFloat("spotlightLight.cutOff", glm::cos(glm::radians(30.0f)));
     shader.SetFloat("spotlightLight.outerCutOff", glm::cos(glm::radians(40.0f)));
     shader.SetVec3("spotlightLight.ambient", 0.1f, 0.1f, 0.1f);
@@ -231,15 +812,116 @@ void UpdateLightningShaderSettings(Shader& shader) {
 
     shader.SetVec3("material.specular", 0.5f, 0.5f, 0.5f);
     shader.SetFloat("material.shininess", 64.0f);
-    shader.SetBool("useBlinn", useBlinn);
 }
 
-void ProcessInput(GLFWwindow* window)
+// the lamp, the spotlight and the optional venue lamps as a list for the deferred and clustered paths,
+// with the same parameters UpdateLightningShaderSettings gives the forward shaders
+void BuildSceneLights(LightList& lights, const FrameSnapshot& frame) {
+    lights.Clear();
+
+    Light lamp = PointLight(sceneGraph.WorldPosition(lampNode), glm::vec3(0.9f), 1.0f, 0.004f, 0.009f);
+    lamp.ambient = glm::vec3(0.2f);
+    lamp.intensity = frame.lampBrightness;
+    lights.Add(lamp);
+
+    if (frame.spotlightActive) {
+        Light spotlight = PointLight(frame.spotlightPosition, glm::vec3(0.8f), 1.0f, 0.09f, 0.032f);
+        spotlight.type = LIGHT_SPOT;
+        spotlight.direction = frame.spotlightDirection;
+        spotlight.cutOff = glm::cos(glm::radians(30.0f));
+        spotlight.outerCutOff = glm::cos(glm::radians(40.0f));
+        spotlight.ambient = glm::vec3(0.1f);
+        lights.Add(spotlight);
+    }
+
+    if (frame.venueLamps) {
+        for (int i = 0; i < VENUE_LAMP_COUNT; i++) {
+            float angle = 2 * MATH_PI * i / VENUE_LAMP_COUNT;
+            glm::vec3 position = sceneGraph.WorldPosition(boardNode) + glm::vec3(std::cos(angle) * VENUE_LAMP_RADIUS, VENUE_LAMP_HEIGHT, std::sin(angle) * VENUE_LAMP_RADIUS);
+            // alternate warm and cool lamps, so single lights stay recognizable
+            glm::vec3 color = i % 2 == 0 ? glm::vec3(0.8f, 0.6f, 0.4f) : glm::vec3(0.4f, 0.5f, 0.8f);
+            Light venueLamp = PointLight(position, color, 1.0f, 0.7f, 1.8f);
+            venueLamp.ambient = glm::vec3(0.0f);
+            lights.Add(venueLamp);
+        }
+    }
+}
+
+// switches the lighting shader variants are specialized for, each mode uses the ones it supports
+unsigned int GetShaderFeatures() {
+    unsigned int features = 0;
+    if (useBlinn)
+        features |= FEATURE_BLINN;
+    if (spotlightLightIsActive)
+        features |= FEATURE_SPOTLIGHT;
+    if (useShadows)
+        features |= FEATURE_SHADOWS;
+    return features;
+}
+
+// the spotlight aims at the board center, the arrow keys move the aim point up and down
+glm::vec3 GetSpotlightDirection() {
+    float spotlight_aim_h = (spotlightAngle + 45) / 10 - 1.5f;
+    glm::vec3 spotlight_aim = glm::vec3(boardCenter.x, spotlight_aim_h, boardCenter.z);
+    return spotlight_aim - spotlightCamera.Position;
+}
+
+// advances the spotlight orbit and captures the cameras, lights and settings the frame is drawn with
+void BuildFrameSnapshot(FrameSnapshot& frame, float time) {
+    frame.time = time;
+    frame.framebufferWidth = framebufferWidth;
+    frame.framebufferHeight = framebufferHeight;
+
+    // the rig orbits the board center, the models on it turn with the orbit and tilt with the aim
+    if (spotlightIsOrbiting)
+        spotlightOrbitTime += deltaTime;
+    float angle = (spotlightOrbitTime / SPOTLIGHT_FULL_TURN_TIME_S) * 2 * MATH_PI;
+    frame.spotlightOffset = glm::vec3(std::cos(angle) * SPOTLIGHT_MOVEMENT_RADIUS,
+        SPOTLIGHT_HEIGHT,
+        std::sin(angle) * SPOTLIGHT_MOVEMENT_RADIUS);
+    frame.spotlightRotation = glm::vec3(spotlightAngle, 0, glm::degrees(angle));
+    spotlightCamera.Position = boardCenter + frame.spotlightOffset;
+    spotlightCamera.Front = boardCenter - spotlightCamera.Position;
+    frame.spotlightPosition = spotlightCamera.Position;
+    frame.spotlightDirection = GetSpotlightDirection();
+    frame.spotlightActive = spotlightLightIsActive;
+    frame.lampBrightness = lampBrightnessLevel / 9;
+
+    frame.view = cameras[currentCameraIndex]->GetViewMatrix();
+    frame.projection = GetProjectionMatrix();
+    frame.viewPosition = cameras[currentCameraIndex]->Position;
+
+    frame.shading = currentShaderIndex;
+    frame.shaderFeatures = GetShaderFeatures();
+    frame.blinn = useBlinn;
+    frame.fogLevel = fogLevel;
+    frame.occlusionCulling = useOcclusionCulling;
+    frame.depthPrepass = useDepthPrepass;
+    frame.shadows = useShadows;
+    frame.venueLamps = venueLampsAreActive;
+    frame.antialiasing = useAntialiasing;
+    frame.justInTime = framePacer.JustInTime && framePacer.VSync;
+    frame.printStats = printFrameStats;
+    frame.settingsVersion = settingsVersion;
+}
+
+// hands the filled back snapshot to the render thread and wakes it
+void PublishFrameSnapshot() {
+    frameSnapshots.Publish();
+    // taking the lock orders the publish before a render thread that is about to sleep checks for it
+    {
+        lock_guard<mutex> lock(snapshotMutex);
+    }
+    snapshotPublished.notify_one();
+}
+
+// debounced toggles compare with the time the input of the frame is sampled at
+void ProcessInput(GLFWwindow* window, float time)
 {
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
-    if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS && (float)glfwGetTime() - lastCameraChangeTime > 0.5f) {
-        lastCameraChangeTime = (float)glfwGetTime();
+    if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS && time - lastCameraChangeTime > 0.5f) {
+        lastCameraChangeTime = time;
         currentCameraIndex = (currentCameraIndex + 1) % 3;
     }
     if (currentCameraIndex == 1) {
@@ -252,21 +934,72 @@ void ProcessInput(GLFWwindow* window)
         if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
             movingCamera.ProcessKeyboard(RIGHT, deltaTime);
     }
-    if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS)
-        currentShaderIndex = 0;
-    if (glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS)
-        currentShaderIndex = 1;
+    if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS && currentShaderIndex != SHADING_PHONG) {
+        currentShaderIndex = SHADING_PHONG;
+        settingsVersion++;
+    }
+    if (glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS && currentShaderIndex != SHADING_GOURAUD) {
+        currentShaderIndex = SHADING_GOURAUD;
+        settingsVersion++;
+    }
+    if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS && currentShaderIndex != SHADING_DEFERRED) {
+        currentShaderIndex = SHADING_DEFERRED;
+        settingsVersion++;
+    }
+    if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS && currentShaderIndex != SHADING_CLUSTERED) {
+        currentShaderIndex = SHADING_CLUSTERED;
+        settingsVersion++;
+    }
+    if (glfwGetKey(window, GLFW_KEY_V) == GLFW_PRESS && time - lastVenueLampsChangeTime > 0.5f) {
+        lastVenueLampsChangeTime = time;
+        venueLampsAreActive = !venueLampsAreActive;
+        settingsVersion++;
+    }
     if (glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS)
         useBlinn = true;
     if (glfwGetKey(window, GLFW_KEY_N) == GLFW_PRESS)
         useBlinn = false;
-    if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS && (float)glfwGetTime() - lastSpotlightChangeTime > 0.25f) {
-        lastSpotlightChangeTime = (float)glfwGetTime();
+    if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS && time - lastSpotlightChangeTime > 0.25f) {
+        lastSpotlightChangeTime = time;
         spotlightLightIsActive = !spotlightLightIsActive;
     }
-    if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS && (float)glfwGetTime() - lastFogChangeTime > 0.5f) {
-        lastFogChangeTime = (float)glfwGetTime();
+    if (glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS && time - lastOrbitChangeTime > 0.5f) {
+        lastOrbitChangeTime = time;
+        spotlightIsOrbiting = !spotlightIsOrbiting;
+    }
+    if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS && time - lastFogChangeTime > 0.5f) {
+        lastFogChangeTime = time;
         fogLevel = (fogLevel + 1) % 4;
+        settingsVersion++;
+    }
+    if (glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS && time - lastOcclusionChangeTime > 0.5f) {
+        lastOcclusionChangeTime = time;
+        useOcclusionCulling = !useOcclusionCulling;
+        settingsVersion++;
+    }
+    if (glfwGetKey(window, GLFW_KEY_Z) == GLFW_PRESS && time - lastDepthPrepassChangeTime > 0.5f) {
+        lastDepthPrepassChangeTime = time;
+        useDepthPrepass = !useDepthPrepass;
+        settingsVersion++;
+    }
+    if (glfwGetKey(window, GLFW_KEY_H) == GLFW_PRESS && time - lastShadowsChangeTime > 0.5f) {
+        lastShadowsChangeTime = time;
+        useShadows = !useShadows;
+        settingsVersion++;
+    }
+    if (glfwGetKey(window, GLFW_KEY_X) == GLFW_PRESS && time - lastAntialiasingChangeTime > 0.5f) {
+        lastAntialiasingChangeTime = time;
+        useAntialiasing = !useAntialiasing;
+        settingsVersion++;
+    }
+    if (glfwGetKey(window, GLFW_KEY_I) == GLFW_PRESS && time - lastStatsChangeTime > 0.5f) {
+        lastStatsChangeTime = time;
+        printFrameStats = !printFrameStats;
+    }
+    if (glfwGetKey(window, GLFW_KEY_J) == GLFW_PRESS && time - lastJustInTimeChangeTime > 0.5f) {
+        lastJustInTimeChangeTime = time;
+        framePacer.JustInTime = !framePacer.JustInTime;
+        settingsVersion++;
     }
     if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS && spotlightAngle < -0.15f)
         spotlightAngle += 0.05;
@@ -296,7 +1029,9 @@ void ProcessInput(GLFWwindow* window)
 
 void FramebufferSizeCallback(GLFWwindow* window, int width, int height)
 {
-    glViewport(0, 0, width, height);
+    // the viewport is set by the thread owning the context when it draws the next snapshot
+    framebufferWidth = width;
+    framebufferHeight = height;
 }
 
 void MouseCallback(GLFWwindow* window, double xpos, double ypos)
@@ -321,3 +1056,18 @@ void ScrollCallback(GLFWwindow* window, double xoffset, double yoffset)
 {
     movingCamera.ProcessMouseScroll(yoffset);
 }
+
+void WindowRefreshCallback(GLFWwindow* window)
+{
+    windowDamaged = true;
+}
+
+// only wakes the on-demand loop, the keys themselves are read by ProcessInput
+void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+    keyEventReceived = true;
+    if (action == GLFW_PRESS)
+        keysHeld++;
+    else if (action == GLFW_RELEASE)
+        keysHeld = std::max(0, keysHeld - 1);
+}
@@ -0,0 +1,178 @@
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include <glm/glm.hpp>
+
+#include <xmmintrin.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+struct AABB {
+    glm::vec3 min;
+    glm::vec3 max;
+
+    AABB() : min(glm::vec3(FLT_MAX)), max(glm::vec3(-FLT_MAX)) {}
+    AABB(glm::vec3 min, glm::vec3 max) : min(min), max(max) {}
+
+    bool IsEmpty() const
+    {
+        return min.x > max.x || min.y > max.y || min.z > max.z;
+    }
+
+    glm::vec3 Center() const
+    {
+        return (min + max) * 0.5f;
+    }
+
+    glm::vec3 Extents() const
+    {
+        return (max - min) * 0.5f;
+    }
+
+    void Merge(const AABB& other)
+    {
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+
+    void Merge(glm::vec3 point)
+    {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+
+    bool Contains(glm::vec3 point) const
+    {
+        return point.x >= min.x && point.y >= min.y && point.z >= min.z
+            && point.x <= max.x && point.y <= max.y && point.z <= max.z;
+    }
+
+    // bounds of this box after an affine transform, computed from center and extents
+    AABB Transform(const glm::mat4& matrix) const
+    {
+        if (IsEmpty()) return *this;
+        glm::vec3 center = glm::vec3(matrix * glm::vec4(Center(), 1.0f));
+        glm::vec3 extents = Extents();
+        glm::vec3 newExtents;
+        for (int i = 0; i < 3; i++)
+            newExtents[i] = std::abs(matrix[0][i]) * extents.x
+                          + std::abs(matrix[1][i]) * extents.y
+                          + std::abs(matrix[2][i]) * extents.z;
+        return AABB(center - newExtents, center + newExtents);
+    }
+};
+
+struct BoundingSphere {
+    glm::vec3 center;
+    float radius;
+
+    BoundingSphere() : center(glm::vec3(0.0f)), radius(0.0f) {}
+    BoundingSphere(glm::vec3 center, float radius) : center(center), radius(radius) {}
+
+    BoundingSphere Transform(const glm::mat4& matrix) const
+    {
+        float scale = std::max(glm::length(glm::vec3(matrix[0])),
+                      std::max(glm::length(glm::vec3(matrix[1])), glm::length(glm::vec3(matrix[2]))));
+        return BoundingSphere(glm::vec3(matrix * glm::vec4(center, 1.0f)), radius * scale);
+    }
+};
+
+enum Frustum_Test {
+    FRUSTUM_OUTSIDE,
+    FRUSTUM_INTERSECTS,
+    FRUSTUM_INSIDE
+};
+
+// View frustum planes stored as structure of arrays, so four planes are tested in one SSE batch.
+// The six planes are padded to eight with planes that accept everything.
+class Frustum
+{
+public:
+    Frustum()
+    {
+        SetFromMatrix(glm::mat4(1.0f));
+    }
+
+    Frustum(const glm::mat4& viewProjection)
+    {
+        SetFromMatrix(viewProjection);
+    }
+
+    // Gribb-Hartmann plane extraction, planes point inwards
+    void SetFromMatrix(const glm::mat4& m)
+    {
+        glm::vec4 row0 = glm::vec4(m[0][0], m[1][0], m[2][0], m[3][0]);
+        glm::vec4 row1 = glm::vec4(m[0][1], m[1][1], m[2][1], m[3][1]);
+        glm::vec4 row2 = glm::vec4(m[0][2], m[1][2], m[2][2], m[3][2]);
+        glm::vec4 row3 = glm::vec4(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+        glm::vec4 planes[PLANE_SLOTS] = {
+            row3 + row0, row3 - row0,
+            row3 + row1, row3 - row1,
+            row3 + row2, row3 - row2,
+            glm::vec4(0, 0, 0, 1), glm::vec4(0, 0, 0, 1)
+        };
+        for (int i = 0; i < PLANE_SLOTS; i++)
+        {
+            float length = glm::length(glm::vec3(planes[i]));
+            if (length > 0.0f)
+                planes[i] /= length;
+            nx[i] = planes[i].x;
+            ny[i] = planes[i].y;
+            nz[i] = planes[i].z;
+            d[i] = planes[i].w;
+        }
+    }
+
+    Frustum_Test TestAABB(const AABB& box) const
+    {
+        glm::vec3 center = box.Center();
+        glm::vec3 extents = box.Extents();
+
+        __m128 cx = _mm_set1_ps(center.x), cy = _mm_set1_ps(center.y), cz = _mm_set1_ps(center.z);
+        __m128 ex = _mm_set1_ps(extents.x), ey = _mm_set1_ps(extents.y), ez = _mm_set1_ps(extents.z);
+        __m128 signMask = _mm_set1_ps(-0.0f);
+
+        int intersecting = 0;
+        for (int i = 0; i < PLANE_SLOTS; i += 4)
+        {
+            __m128 px = _mm_loadu_ps(nx + i), py = _mm_loadu_ps(ny + i), pz = _mm_loadu_ps(nz + i);
+            // signed distance of the center and projected radius of the box for four planes
+            __m128 distance = _mm_add_ps(_mm_loadu_ps(d + i),
+                _mm_add_ps(_mm_mul_ps(px, cx), _mm_add_ps(_mm_mul_ps(py, cy), _mm_mul_ps(pz, cz))));
+            __m128 radius = _mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, px), ex),
+                _mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, py), ey), _mm_mul_ps(_mm_andnot_ps(signMask, pz), ez)));
+
+            if (_mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps())))
+                return FRUSTUM_OUTSIDE;
+            intersecting |= _mm_movemask_ps(_mm_cmplt_ps(_mm_sub_ps(distance, radius), _mm_setzero_ps()));
+        }
+        return intersecting ? FRUSTUM_INTERSECTS : FRUSTUM_INSIDE;
+    }
+
+    bool IntersectsSphere(const BoundingSphere& sphere) const
+    {
+        __m128 cx = _mm_set1_ps(sphere.center.x), cy = _mm_set1_ps(sphere.center.y), cz = _mm_set1_ps(sphere.center.z);
+        __m128 negRadius = _mm_set1_ps(-sphere.radius);
+        for (int i = 0; i < PLANE_SLOTS; i += 4)
+        {
+            __m128 distance = _mm_add_ps(_mm_loadu_ps(d + i),
+                _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(nx + i), cx),
+                _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(ny + i), cy), _mm_mul_ps(_mm_loadu_ps(nz + i), cz))));
+            if (_mm_movemask_ps(_mm_cmplt_ps(distance, negRadius)))
+                return false;
+        }
+        return true;
+    }
+
+private:
+    enum { PLANE_SLOTS = 8 };
+
+    alignas(16) float nx[PLANE_SLOTS];
+    alignas(16) float ny[PLANE_SLOTS];
+    alignas(16) float nz[PLANE_SLOTS];
+    alignas(16) float d[PLANE_SLOTS];
+};
+#endif
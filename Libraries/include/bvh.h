@@ -0,0 +1,203 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <bounds.h>
+
+#include <algorithm>
+#include <vector>
+using namespace std;
+
+const unsigned int BVH_LEAF_SIZE = 4;
+
+struct CullStats {
+    unsigned int visible;
+    unsigned int culled;      // outside of the frustum
+    unsigned int occluded;    // inside of the frustum, rejected by a later stage
+    unsigned int nodesTested;
+};
+
+// Small bounding volume hierarchy over the world bounds of scene objects.
+// Objects are registered once, moving objects only update their bounds and the tree is refitted,
+// it is rebuilt only when objects are added.
+class SceneBVH
+{
+public:
+    CullStats stats;
+
+    SceneBVH()
+    {
+        stats = CullStats();
+    }
+
+    unsigned int AddObject(const AABB& worldBounds)
+    {
+        objects.push_back(worldBounds);
+        visible.push_back(1);
+        dirty = true;
+        return (unsigned int)objects.size() - 1;
+    }
+
+    void UpdateObject(unsigned int id, const AABB& worldBounds)
+    {
+        objects[id] = worldBounds;
+        refit = true;
+    }
+
+    const AABB& GetBounds(unsigned int id) const
+    {
+        return objects[id];
+    }
+
+    unsigned int ObjectCount() const
+    {
+        return (unsigned int)objects.size();
+    }
+
+    // marks every object as visible or culled for the given frustum
+    void Cull(const Frustum& frustum)
+    {
+        if (dirty)
+            Build();
+        else if (refit)
+            Refit();
+
+        stats = CullStats();
+        std::fill(visible.begin(), visible.end(), (char)0);
+        if (!nodes.empty())
+            CullNode(0, frustum, false);
+        stats.visible = 0;
+        for (unsigned int i = 0; i < visible.size(); i++)
+            stats.visible += visible[i];
+        stats.culled = (unsigned int)objects.size() - stats.visible;
+    }
+
+    bool IsVisible(unsigned int id) const
+    {
+        return visible[id] != 0;
+    }
+
+    // lets later culling stages reject an object that passed the frustum test
+    void Hide(unsigned int id)
+    {
+        if (!visible[id]) return;
+        visible[id] = 0;
+        stats.visible--;
+        stats.occluded++;
+    }
+
+private:
+    struct Node {
+        AABB bounds;
+        unsigned int first;  // first child node, or first entry in objectOrder for leaves
+        unsigned int count;  // number of objects, zero for inner nodes
+    };
+
+    vector<AABB>         objects;
+    vector<char>         visible;
+    vector<Node>         nodes;
+    vector<unsigned int> objectOrder;
+    bool dirty = false;
+    bool refit = false;
+
+    void Build()
+    {
+        nodes.clear();
+        objectOrder.resize(objects.size());
+        for (unsigned int i = 0; i < objectOrder.size(); i++)
+            objectOrder[i] = i;
+        if (!objects.empty())
+        {
+            nodes.push_back(Node());
+            BuildNode(0, 0, (unsigned int)objectOrder.size());
+        }
+        dirty = false;
+        refit = false;
+    }
+
+    void BuildNode(unsigned int nodeIndex, unsigned int first, unsigned int count)
+    {
+        AABB bounds;
+        AABB centers;
+        for (unsigned int i = first; i < first + count; i++)
+        {
+            bounds.Merge(objects[objectOrder[i]]);
+            centers.Merge(objects[objectOrder[i]].Center());
+        }
+        nodes[nodeIndex].bounds = bounds;
+
+        if (count <= BVH_LEAF_SIZE)
+        {
+            nodes[nodeIndex].first = first;
+            nodes[nodeIndex].count = count;
+            return;
+        }
+
+        // median split along the axis with the largest spread of object centers
+        glm::vec3 spread = centers.max - centers.min;
+        int axis = spread.x > spread.y ? (spread.x > spread.z ? 0 : 2) : (spread.y > spread.z ? 1 : 2);
+        unsigned int half = count / 2;
+        std::nth_element(objectOrder.begin() + first, objectOrder.begin() + first + half, objectOrder.begin() + first + count,
+            [this, axis](unsigned int a, unsigned int b) {
+                return objects[a].Center()[axis] < objects[b].Center()[axis];
+            });
+
+        // children are stored next to each other, always after their parent
+        unsigned int left = (unsigned int)nodes.size();
+        nodes.push_back(Node());
+        nodes.push_back(Node());
+        nodes[nodeIndex].first = left;
+        nodes[nodeIndex].count = 0;
+        BuildNode(left, first, half);
+        BuildNode(left + 1, first + half, count - half);
+    }
+
+    void Refit()
+    {
+        // children always follow their parent, so a reverse walk sees children first
+        for (int i = (int)nodes.size() - 1; i >= 0; i--)
+        {
+            Node& node = nodes[i];
+            AABB bounds;
+            if (node.count > 0)
+            {
+                for (unsigned int j = node.first; j < node.first + node.count; j++)
+                    bounds.Merge(objects[objectOrder[j]]);
+            }
+            else
+            {
+                bounds.Merge(nodes[node.first].bounds);
+                bounds.Merge(nodes[node.first + 1].bounds);
+            }
+            node.bounds = bounds;
+        }
+        refit = false;
+    }
+
+    void CullNode(unsigned int nodeIndex, const Frustum& frustum, bool insideParent)
+    {
+        const Node& node = nodes[nodeIndex];
+        if (!insideParent)
+        {
+            stats.nodesTested++;
+            Frustum_Test test = frustum.TestAABB(node.bounds);
+            if (test == FRUSTUM_OUTSIDE)
+                return;
+            insideParent = test == FRUSTUM_INSIDE;
+        }
+
+        if (node.count == 0)
+        {
+            CullNode(node.first, frustum, insideParent);
+            CullNode(node.first + 1, frustum, insideParent);
+            return;
+        }
+
+        for (unsigned int i = node.first; i < node.first + node.count; i++)
+        {
+            unsigned int id = objectOrder[i];
+            if (insideParent || frustum.TestAABB(objects[id]) != FRUSTUM_OUTSIDE)
+                visible[id] = 1;
+        }
+    }
+};
+#endif
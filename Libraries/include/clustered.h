@@ -0,0 +1,267 @@
+#ifndef CLUSTERED_H
+#define CLUSTERED_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <shader.h>
+#include <glstate.h>
+#include <lights.h>
+
+#include <xmmintrin.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+using namespace std;
+
+const int CLUSTER_GRID_X = 16;
+const int CLUSTER_GRID_Y = 9;
+const int CLUSTER_GRID_Z = 24;
+const int CLUSTER_COUNT  = CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z;
+
+// texels of RGBA32F light data per light, see PackLight
+const int CLUSTER_LIGHT_TEXELS = 6;
+
+// texture units of the light buffers, above the units meshes bind their materials to
+const unsigned int CLUSTER_LIGHTS_UNIT  = 8;
+const unsigned int CLUSTER_GRID_UNIT    = 9;
+const unsigned int CLUSTER_INDICES_UNIT = 10;
+
+// Clustered forward lighting. The view frustum is split into a grid of tiles and exponential depth
+// slices, every frame the lights are assigned to the clusters they touch on the CPU (four clusters
+// per SSE sphere/box test) and the result is uploaded as texture buffers. The clustered Phong shader
+// then loops only over the lights of the cluster a fragment falls into.
+// The context is OpenGL 3.3, which has no compute shaders, so the assignment always runs on the CPU.
+class ClusteredLighting
+{
+public:
+    unsigned int LastIndexCount = 0;
+
+    ClusteredLighting()
+    {
+        lightsBuffer = CreateTextureBuffer(GL_RGBA32F, lightsTexture);
+        gridBuffer = CreateTextureBuffer(GL_RG32UI, gridTexture);
+        indicesBuffer = CreateTextureBuffer(GL_R32UI, indicesTexture);
+
+        grid.resize(CLUSTER_COUNT * 2);
+        counts.resize(CLUSTER_COUNT);
+        for (int i = 0; i < 6; i++)
+            clusterBounds[i].resize(CLUSTER_COUNT);
+        lastProjection = glm::mat4(0.0f);
+    }
+
+    // assigns the lights to clusters and uploads the light data, the grid and the index list
+    void Update(const LightList& lights, const glm::mat4& projection, const glm::mat4& view, float nearPlane, float farPlane)
+    {
+        this->nearPlane = nearPlane;
+        this->farPlane = farPlane;
+        if (projection != lastProjection)
+        {
+            BuildClusterBounds(projection);
+            lastProjection = projection;
+        }
+
+        AssignLights(lights, view);
+
+        packedLights.resize(lights.Size() * CLUSTER_LIGHT_TEXELS);
+        for (unsigned int i = 0; i < lights.Size(); i++)
+            PackLight(lights.lights[i], &packedLights[i * CLUSTER_LIGHT_TEXELS]);
+
+        Upload(lightsBuffer, packedLights.empty() ? nullptr : &packedLights[0], packedLights.size() * sizeof(glm::vec4));
+        Upload(gridBuffer, &grid[0], grid.size() * sizeof(unsigned int));
+        Upload(indicesBuffer, indices.empty() ? nullptr : &indices[0], indices.size() * sizeof(unsigned int));
+        LastIndexCount = (unsigned int)indices.size();
+    }
+
+    // binds the buffers and sets the cluster uniforms of a clustered lighting shader
+    void Bind(Shader& shader, int screenWidth, int screenHeight)
+    {
+        shader.Use();
+        glState.BindTexture(CLUSTER_LIGHTS_UNIT, GL_TEXTURE_BUFFER, lightsTexture);
+        glState.BindTexture(CLUSTER_GRID_UNIT, GL_TEXTURE_BUFFER, gridTexture);
+        glState.BindTexture(CLUSTER_INDICES_UNIT, GL_TEXTURE_BUFFER, indicesTexture);
+        shader.SetInt("clusterLights", CLUSTER_LIGHTS_UNIT);
+        shader.SetInt("clusterGrid", CLUSTER_GRID_UNIT);
+        shader.SetInt("clusterIndices", CLUSTER_INDICES_UNIT);
+        shader.SetVec3("clusterGridSize", glm::vec3(CLUSTER_GRID_X, CLUSTER_GRID_Y, CLUSTER_GRID_Z));
+        shader.SetVec2("screenSize", glm::vec2((float)screenWidth, (float)screenHeight));
+        shader.SetFloat("nearPlane", nearPlane);
+        shader.SetFloat("farPlane", farPlane);
+    }
+
+private:
+    unsigned int lightsBuffer, gridBuffer, indicesBuffer;
+    unsigned int lightsTexture, gridTexture, indicesTexture;
+    float nearPlane, farPlane;
+    glm::mat4 lastProjection;
+
+    // view space cluster boxes as structure of arrays: min x, y, z, max x, y, z
+    vector<float> clusterBounds[6];
+    vector<unsigned int> grid;      // offset and count per cluster
+    vector<unsigned int> counts;
+    vector<unsigned int> indices;
+    vector<glm::vec4> packedLights;
+    vector<glm::vec4> viewSpheres;
+
+    static unsigned int CreateTextureBuffer(GLenum format, unsigned int& texture)
+    {
+        unsigned int buffer;
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        glBufferData(GL_TEXTURE_BUFFER, sizeof(glm::vec4), NULL, GL_STREAM_DRAW);
+        glGenTextures(1, &texture);
+        glState.BindTexture(CLUSTER_LIGHTS_UNIT, GL_TEXTURE_BUFFER, texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+        return buffer;
+    }
+
+    static void Upload(unsigned int buffer, const void* data, size_t size)
+    {
+        // orphan the old storage, the driver hands out a fresh block instead of waiting for the GPU
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        glBufferData(GL_TEXTURE_BUFFER, size > 0 ? size : sizeof(glm::vec4), NULL, GL_STREAM_DRAW);
+        if (size > 0)
+            glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+    }
+
+    float SliceDepth(int slice) const
+    {
+        return nearPlane * std::pow(farPlane / nearPlane, (float)slice / CLUSTER_GRID_Z);
+    }
+
+    void BuildClusterBounds(const glm::mat4& projection)
+    {
+        // symmetric perspective: a view space point at depth d projects to ndc = (x * p00, y * p11) / d
+        float invX = 1.0f / projection[0][0];
+        float invY = 1.0f / projection[1][1];
+
+        for (int z = 0; z < CLUSTER_GRID_Z; z++)
+        {
+            float nearDepth = SliceDepth(z);
+            float farDepth = SliceDepth(z + 1);
+            for (int y = 0; y < CLUSTER_GRID_Y; y++)
+            {
+                float ndcMinY = -1.0f + 2.0f * y / CLUSTER_GRID_Y;
+                float ndcMaxY = -1.0f + 2.0f * (y + 1) / CLUSTER_GRID_Y;
+                for (int x = 0; x < CLUSTER_GRID_X; x++)
+                {
+                    float ndcMinX = -1.0f + 2.0f * x / CLUSTER_GRID_X;
+                    float ndcMaxX = -1.0f + 2.0f * (x + 1) / CLUSTER_GRID_X;
+
+                    // the tile widens with depth, so the box spans both depths of the slice
+                    float minX = std::min(ndcMinX * nearDepth, ndcMinX * farDepth) * invX;
+                    float maxX = std::max(ndcMaxX * nearDepth, ndcMaxX * farDepth) * invX;
+                    float minY = std::min(ndcMinY * nearDepth, ndcMinY * farDepth) * invY;
+                    float maxY = std::max(ndcMaxY * nearDepth, ndcMaxY * farDepth) * invY;
+
+                    int index = ClusterIndex(x, y, z);
+                    clusterBounds[0][index] = minX;
+                    clusterBounds[1][index] = minY;
+                    clusterBounds[2][index] = -farDepth;
+                    clusterBounds[3][index] = maxX;
+                    clusterBounds[4][index] = maxY;
+                    clusterBounds[5][index] = -nearDepth;
+                }
+            }
+        }
+    }
+
+    static int ClusterIndex(int x, int y, int z)
+    {
+        return x + CLUSTER_GRID_X * (y + CLUSTER_GRID_Y * z);
+    }
+
+    int SliceOf(float depth) const
+    {
+        if (depth <= nearPlane) return 0;
+        int slice = (int)std::floor(std::log(depth / nearPlane) / std::log(farPlane / nearPlane) * CLUSTER_GRID_Z);
+        return std::min(std::max(slice, 0), CLUSTER_GRID_Z - 1);
+    }
+
+    // tests one view space sphere against the clusters of a slice range, four at a time
+    template <typename Visitor>
+    void ForEachTouchedCluster(glm::vec4 sphere, int firstSlice, int lastSlice, Visitor visit)
+    {
+        __m128 cx = _mm_set1_ps(sphere.x), cy = _mm_set1_ps(sphere.y), cz = _mm_set1_ps(sphere.z);
+        __m128 radiusSquared = _mm_set1_ps(sphere.w * sphere.w);
+        __m128 zero = _mm_setzero_ps();
+
+        int first = ClusterIndex(0, 0, firstSlice);
+        int last = ClusterIndex(0, 0, lastSlice + 1);
+        for (int i = first; i < last; i += 4)
+        {
+            // distance from the sphere center to the box, per axis max(0, min - c, c - max)
+            __m128 dx = _mm_max_ps(zero, _mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&clusterBounds[0][i]), cx), _mm_sub_ps(cx, _mm_loadu_ps(&clusterBounds[3][i]))));
+            __m128 dy = _mm_max_ps(zero, _mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&clusterBounds[1][i]), cy), _mm_sub_ps(cy, _mm_loadu_ps(&clusterBounds[4][i]))));
+            __m128 dz = _mm_max_ps(zero, _mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&clusterBounds[2][i]), cz), _mm_sub_ps(cz, _mm_loadu_ps(&clusterBounds[5][i]))));
+            __m128 distanceSquared = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_add_ps(_mm_mul_ps(dy, dy), _mm_mul_ps(dz, dz)));
+
+            int mask = _mm_movemask_ps(_mm_cmple_ps(distanceSquared, radiusSquared));
+            for (int lane = 0; lane < 4; lane++)
+                if (mask & (1 << lane))
+                    visit(i + lane);
+        }
+    }
+
+    void AssignLights(const LightList& lights, const glm::mat4& view)
+    {
+        viewSpheres.resize(lights.Size());
+        for (unsigned int i = 0; i < lights.Size(); i++)
+        {
+            glm::vec3 center = glm::vec3(view * glm::vec4(lights.lights[i].position, 1.0f));
+            viewSpheres[i] = glm::vec4(center, lights.lights[i].Radius());
+        }
+
+        // first pass counts, second pass writes into the offsets, so the index list is one flat array
+        std::fill(counts.begin(), counts.end(), 0u);
+        for (unsigned int i = 0; i < viewSpheres.size(); i++)
+        {
+            int firstSlice, lastSlice;
+            if (!SliceRange(viewSpheres[i], firstSlice, lastSlice)) continue;
+            ForEachTouchedCluster(viewSpheres[i], firstSlice, lastSlice, [this](int cluster) { counts[cluster]++; });
+        }
+
+        unsigned int offset = 0;
+        for (int cluster = 0; cluster < CLUSTER_COUNT; cluster++)
+        {
+            grid[cluster * 2] = offset;
+            grid[cluster * 2 + 1] = 0;
+            offset += counts[cluster];
+        }
+        indices.resize(offset);
+
+        for (unsigned int i = 0; i < viewSpheres.size(); i++)
+        {
+            int firstSlice, lastSlice;
+            if (!SliceRange(viewSpheres[i], firstSlice, lastSlice)) continue;
+            ForEachTouchedCluster(viewSpheres[i], firstSlice, lastSlice, [this, i](int cluster) {
+                indices[grid[cluster * 2] + grid[cluster * 2 + 1]++] = i;
+            });
+        }
+    }
+
+    bool SliceRange(glm::vec4 sphere, int& firstSlice, int& lastSlice) const
+    {
+        float nearest = -sphere.z - sphere.w;
+        float farthest = -sphere.z + sphere.w;
+        if (sphere.w <= 0.0f || farthest < nearPlane || nearest > farPlane) return false;
+        firstSlice = SliceOf(nearest);
+        lastSlice = SliceOf(farthest);
+        return true;
+    }
+
+    // texel layout: position + type, direction + cutOff, ambient + outerCutOff,
+    // intensity * diffuse, intensity * specular, attenuation constant, linear, quadratic
+    static void PackLight(const Light& light, glm::vec4* texels)
+    {
+        texels[0] = glm::vec4(light.position, (float)light.type);
+        texels[1] = glm::vec4(glm::normalize(light.direction), light.cutOff);
+        texels[2] = glm::vec4(light.ambient, light.outerCutOff);
+        texels[3] = glm::vec4(light.intensity * light.diffuse, 0.0f);
+        texels[4] = glm::vec4(light.intensity * light.specular, 0.0f);
+        texels[5] = glm::vec4(light.constant, light.linear, light.quadratic, 0.0f);
+    }
+};
+#endif
@@ -0,0 +1,248 @@
+#ifndef DEFERRED_H
+#define DEFERRED_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <shader.h>
+#include <glstate.h>
+#include <lights.h>
+#include <renderqueue.h>
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+using namespace std;
+
+const int LIGHT_VOLUME_SEGMENTS = 12;
+const int LIGHT_VOLUME_RINGS    = 8;
+
+// Deferred shading path. The geometry pass writes albedo, specular and normals into a G-buffer,
+// then every light is drawn as a sphere volume that only shades the pixels it can reach, so the
+// cost grows with the lit screen area instead of with fragments times lights.
+//
+// G-buffer layout:
+//   0: RGBA8   albedo.rgb, specular intensity
+//   1: RGBA16F world space normal
+//   depth: DEPTH24_STENCIL8, world positions are reconstructed from it
+// The targets have the window size, a smaller scene only uses their lower left part like the
+// post-processing targets, so a new scale of the dynamic resolution never reallocates them.
+class DeferredRenderer
+{
+public:
+    DeferredRenderer(const char* shaderDirectory)
+        : lightShader((string(shaderDirectory) + "bounds_shader.vert").c_str(), (string(shaderDirectory) + "deferred_light_shader.frag").c_str()),
+          baseShader((string(shaderDirectory) + "fullscreen_shader.vert").c_str(), (string(shaderDirectory) + "deferred_base_shader.frag").c_str())
+    {
+        width = 0;
+        height = 0;
+        targetWidth = 0;
+        targetHeight = 0;
+        framebuffer = 0;
+        SetupLightVolume();
+        glGenVertexArrays(1, &emptyVAO);
+    }
+
+    // sets the scene size the next passes draw at, recreates the G-buffer when the window size changed
+    void Resize(int windowWidth, int windowHeight, int sceneWidth, int sceneHeight)
+    {
+        width = sceneWidth;
+        height = sceneHeight;
+        if (windowWidth == targetWidth && windowHeight == targetHeight) return;
+        if (windowWidth <= 0 || windowHeight <= 0) return;
+        targetWidth = windowWidth;
+        targetHeight = windowHeight;
+
+        if (framebuffer != 0)
+        {
+            glDeleteFramebuffers(1, &framebuffer);
+            glDeleteTextures(1, &albedoSpecTexture);
+            glDeleteTextures(1, &normalTexture);
+            glDeleteTextures(1, &depthTexture);
+            glState.Invalidate();
+        }
+
+        glGenFramebuffers(1, &framebuffer);
+        glState.BindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+        albedoSpecTexture = CreateTexture(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedoSpecTexture, 0);
+        normalTexture = CreateTexture(GL_RGBA16F, GL_RGBA, GL_FLOAT);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normalTexture, 0);
+        depthTexture = CreateTexture(GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+
+        unsigned int attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+        glDrawBuffers(2, attachments);
+
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::DEFERRED::GBUFFER_INCOMPLETE" << std::endl;
+        glState.BindFramebuffer(GL_FRAMEBUFFER, glState.SceneFramebuffer);
+    }
+
+    // fills the G-buffer with the opaque packets, they have to be submitted with the G-buffer shader
+    void GeometryPass(RenderQueue& queue)
+    {
+        glState.BindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        queue.Execute(PASS_OPAQUE, PASS_OPAQUE);
+        glState.BindFramebuffer(GL_FRAMEBUFFER, glState.SceneFramebuffer);
+    }
+
+    // lights the scene framebuffer, afterwards it holds the scene depth for forward passes
+    void LightingPass(const LightList& lights, const glm::mat4& projection, const glm::mat4& view, glm::vec3 viewPos, bool useBlinn)
+    {
+        glm::mat4 inverseViewProjection = glm::inverse(projection * view);
+
+        // forward passes after this one depth test against the G-buffer depth
+        glState.BindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        glState.BindFramebuffer(GL_DRAW_FRAMEBUFFER, glState.SceneFramebuffer);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        glState.BindFramebuffer(GL_FRAMEBUFFER, glState.SceneFramebuffer);
+
+        glState.BindTexture(0, GL_TEXTURE_2D, albedoSpecTexture);
+        glState.BindTexture(1, GL_TEXTURE_2D, normalTexture);
+        glState.BindTexture(2, GL_TEXTURE_2D, depthTexture);
+        glState.DepthMask(false);
+
+        // geometry pixels start from black, background keeps the clear color
+        glState.Disable(GL_DEPTH_TEST);
+        baseShader.Use();
+        baseShader.SetInt("gDepth", 2);
+        glState.BindVertexArray(emptyVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        // back faces of the volume behind the geometry, this also works with the camera inside
+        // clamping keeps back faces beyond the far plane of large volumes from being clipped
+        glState.Enable(GL_DEPTH_TEST);
+        glState.Enable(GL_DEPTH_CLAMP);
+        glState.DepthFunc(GL_GEQUAL);
+        glState.Enable(GL_CULL_FACE);
+        glCullFace(GL_FRONT);
+        glState.Enable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+
+        lightShader.Use();
+        lightShader.SetInt("gAlbedoSpec", 0);
+        lightShader.SetInt("gNormal", 1);
+        lightShader.SetInt("gDepth", 2);
+        lightShader.SetVec2("screenSize", glm::vec2((float)width, (float)height));
+        lightShader.SetMat4("inverseViewProjection", inverseViewProjection);
+        lightShader.SetMat4("projection", projection);
+        lightShader.SetMat4("view", view);
+        lightShader.SetVec3("viewPos", viewPos);
+        lightShader.SetBool("useBlinn", useBlinn);
+        glState.BindVertexArray(volumeVAO);
+
+        for (unsigned int i = 0; i < lights.lights.size(); i++)
+        {
+            const Light& light = lights.lights[i];
+            float radius = light.Radius();
+            if (radius <= 0.0f) continue;
+
+            glm::mat4 model = glm::translate(glm::mat4(1.0f), light.position);
+            model = glm::scale(model, glm::vec3(radius));
+            lightShader.SetMat4("model", model);
+            SetLightUniforms(light);
+            glDrawElements(GL_TRIANGLES, volumeIndexCount, GL_UNSIGNED_INT, 0);
+        }
+
+        glState.Disable(GL_BLEND);
+        glCullFace(GL_BACK);
+        glState.Disable(GL_CULL_FACE);
+        glState.Disable(GL_DEPTH_CLAMP);
+        glState.DepthFunc(GL_LESS);
+        glState.DepthMask(true);
+    }
+
+private:
+    Shader lightShader;
+    Shader baseShader;
+    int width, height;
+    int targetWidth, targetHeight;
+    unsigned int framebuffer;
+    unsigned int albedoSpecTexture, normalTexture, depthTexture;
+    unsigned int volumeVAO, volumeVBO, volumeEBO;
+    unsigned int volumeIndexCount;
+    unsigned int emptyVAO;
+
+    unsigned int CreateTexture(GLint internalFormat, GLenum format, GLenum type)
+    {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        glState.BindTexture(0, GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, targetWidth, targetHeight, 0, format, type, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        return texture;
+    }
+
+    void SetLightUniforms(const Light& light)
+    {
+        lightShader.SetInt("light.type", (int)light.type);
+        lightShader.SetVec3("light.position", light.position);
+        lightShader.SetVec3("light.direction", light.direction);
+        lightShader.SetFloat("light.cutOff", light.cutOff);
+        lightShader.SetFloat("light.outerCutOff", light.outerCutOff);
+        lightShader.SetVec3("light.ambient", light.ambient);
+        lightShader.SetVec3("light.diffuse", light.diffuse);
+        lightShader.SetVec3("light.specular", light.specular);
+        lightShader.SetFloat("light.constant", light.constant);
+        lightShader.SetFloat("light.linear", light.linear);
+        lightShader.SetFloat("light.quadratic", light.quadratic);
+        lightShader.SetFloat("light.intensity", light.intensity);
+    }
+
+    // UV sphere circumscribing the unit sphere, so the flat faces never cut into the light range
+    void SetupLightVolume()
+    {
+        vector<glm::vec3> vertices;
+        vector<unsigned int> indices;
+        float scale = 1.0f / (std::cos(3.14159265359f / LIGHT_VOLUME_RINGS) * std::cos(3.14159265359f / LIGHT_VOLUME_SEGMENTS));
+
+        for (int ring = 0; ring <= LIGHT_VOLUME_RINGS; ring++)
+        {
+            float phi = 3.14159265359f * ring / LIGHT_VOLUME_RINGS;
+            for (int segment = 0; segment <= LIGHT_VOLUME_SEGMENTS; segment++)
+            {
+                float theta = 2.0f * 3.14159265359f * segment / LIGHT_VOLUME_SEGMENTS;
+                vertices.push_back(scale * glm::vec3(std::sin(phi) * std::cos(theta), std::cos(phi), std::sin(phi) * std::sin(theta)));
+            }
+        }
+        for (int ring = 0; ring < LIGHT_VOLUME_RINGS; ring++)
+        {
+            for (int segment = 0; segment < LIGHT_VOLUME_SEGMENTS; segment++)
+            {
+                unsigned int current = ring * (LIGHT_VOLUME_SEGMENTS + 1) + segment;
+                unsigned int below = current + LIGHT_VOLUME_SEGMENTS + 1;
+                indices.push_back(current);
+                indices.push_back(current + 1);
+                indices.push_back(below);
+                indices.push_back(current + 1);
+                indices.push_back(below + 1);
+                indices.push_back(below);
+            }
+        }
+        volumeIndexCount = (unsigned int)indices.size();
+
+        glGenVertexArrays(1, &volumeVAO);
+        glGenBuffers(1, &volumeVBO);
+        glGenBuffers(1, &volumeEBO);
+
+        glState.BindVertexArray(volumeVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, volumeVBO);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), &vertices[0], GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, volumeEBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+        glState.BindVertexArray(0);
+    }
+};
+#endif
@@ -0,0 +1,180 @@
+#ifndef ENTITIES_H
+#define ENTITIES_H
+
+#include <glm/glm.hpp>
+
+#include <model.h>
+#include <bounds.h>
+#include <bvh.h>
+#include <renderqueue.h>
+#include <scenegraph.h>
+#include <jobs.h>
+
+#include <vector>
+using namespace std;
+
+enum Entity_Flag {
+    ENTITY_ENABLED      = 1 << 0,
+    ENTITY_CASTS_SHADOW = 1 << 1,
+    ENTITY_OCCLUDEE     = 1 << 2  // tested against the occluders before it is drawn
+};
+
+const unsigned int ENTITY_NO_OBJECT = 0xFFFFFFFF;
+// entities per culling and recording job, scenes up to this size are handled on the calling thread
+const unsigned int ENTITY_JOB_GRAIN = 256;
+
+// Scene objects as entities, an entity is an index into parallel component arrays: its scene
+// graph node (the transform), the model it draws (meshes and materials), the pass and brightness
+// it is drawn with, its bounds in the scene BVH and its flags. The systems below walk the arrays
+// linearly, the only indirection is the shared model table. Culling and draw packet generation
+// are split into jobs, each recording its slice of the entities into its own draw list.
+class EntityStore
+{
+public:
+    // models are shared by all entities drawing them, loaded once
+    unsigned int AddModel(const Model& model)
+    {
+        models.push_back(model);
+        return (unsigned int)models.size() - 1;
+    }
+
+    Model& GetModel(unsigned int model)
+    {
+        return models[model];
+    }
+
+    unsigned int Create(unsigned int model, unsigned int node, Render_Pass pass = PASS_OPAQUE, unsigned int flags = ENTITY_ENABLED)
+    {
+        nodes.push_back(node);
+        modelIndices.push_back(model);
+        passes.push_back((unsigned char)pass);
+        brightness.push_back(1.0f);
+        objectIds.push_back(ENTITY_NO_OBJECT);
+        this->flags.push_back((unsigned char)flags);
+        return (unsigned int)nodes.size() - 1;
+    }
+
+    // places a new copy of the model under the given scene node and creates an entity drawing it
+    unsigned int Spawn(unsigned int model, unsigned int parentNode, Render_Pass pass = PASS_OPAQUE, unsigned int flags = ENTITY_ENABLED)
+    {
+        return Create(model, models[model].AddNode(parentNode), pass, flags);
+    }
+
+    void SetEnabled(unsigned int entity, bool enabled)
+    {
+        if (enabled) flags[entity] |= ENTITY_ENABLED;
+        else flags[entity] &= ~ENTITY_ENABLED;
+    }
+
+    void SetBrightness(unsigned int entity, float value)
+    {
+        brightness[entity] = value;
+    }
+
+    unsigned int Node(unsigned int entity) const
+    {
+        return nodes[entity];
+    }
+
+    unsigned int ModelIndex(unsigned int entity) const
+    {
+        return modelIndices[entity];
+    }
+
+    unsigned int Size() const
+    {
+        return (unsigned int)nodes.size();
+    }
+
+    // changes whenever a shadow caster moved, cached shadow maps compare it to know when to re-render
+    unsigned int CastersVersion() const
+    {
+        return castersVersion;
+    }
+
+    // adds the entities created since the last call to the scene BVH, the scene graph has to be up to date
+    void RegisterBounds(SceneBVH& bvh)
+    {
+        for (unsigned int entity = 0; entity < nodes.size(); entity++)
+            if (objectIds[entity] == ENTITY_NO_OBJECT)
+                objectIds[entity] = bvh.AddObject(models[modelIndices[entity]].GetWorldBounds(nodes[entity]));
+    }
+
+    // refits the bounds of every entity the last scene graph update moved
+    void UpdateBounds(SceneBVH& bvh)
+    {
+        bool castersMoved = false;
+        for (unsigned int entity = 0; entity < nodes.size(); entity++)
+        {
+            if (!sceneGraph.Changed(nodes[entity])) continue;
+            bvh.UpdateObject(objectIds[entity], models[modelIndices[entity]].GetWorldBounds(nodes[entity]));
+            if (flags[entity] & ENTITY_CASTS_SHADOW)
+                castersMoved = true;
+        }
+        if (castersMoved)
+            castersVersion++;
+    }
+
+    // queues the enabled entities the BVH left visible, emissive ones with their own program.
+    // The lists are merged in slice order, so the queue is the same with any number of workers.
+    void Submit(RenderQueue& queue, Shader& shader, Shader& emissiveShader, const SceneBVH& bvh, const Frustum& frustum)
+    {
+        unsigned int count = (unsigned int)nodes.size();
+        drawLists.resize((count + ENTITY_JOB_GRAIN - 1) / ENTITY_JOB_GRAIN);
+        glm::vec3 viewPos = queue.ViewPosition();
+        jobSystem.ParallelFor(count, ENTITY_JOB_GRAIN, [&](unsigned int begin, unsigned int end) {
+            DrawList& list = drawLists[begin / ENTITY_JOB_GRAIN];
+            list.Begin(viewPos);
+            for (unsigned int entity = begin; entity < end; entity++)
+            {
+                if (!(flags[entity] & ENTITY_ENABLED) || !bvh.IsVisible(objectIds[entity]))
+                    continue;
+                Model& model = models[modelIndices[entity]];
+                unsigned int meshMask = model.VisibleMeshes(nodes[entity], &frustum);
+                if (meshMask == 0)
+                    continue;
+                Render_Pass pass = (Render_Pass)passes[entity];
+                model.SubmitMeshes(list, pass, pass == PASS_EMISSIVE ? emissiveShader : shader,
+                    nodes[entity], meshMask, brightness[entity]);
+            }
+        });
+
+        for (const DrawList& list : drawLists)
+            queue.Append(list);
+    }
+
+    // every shadow caster regardless of the camera, meshes are culled against the light frustum if given
+    void SubmitShadowCasters(RenderQueue& queue, Shader& shader, const Frustum* frustum = nullptr)
+    {
+        const unsigned char casterFlags = ENTITY_ENABLED | ENTITY_CASTS_SHADOW;
+        for (unsigned int entity = 0; entity < nodes.size(); entity++)
+            if ((flags[entity] & casterFlags) == casterFlags)
+                models[modelIndices[entity]].Submit(queue, PASS_OPAQUE, shader, nodes[entity], frustum);
+    }
+
+    // scene object ids of the entities with all of the given flags
+    void GetObjectIds(vector<unsigned int>& ids, unsigned int withFlags) const
+    {
+        for (unsigned int entity = 0; entity < nodes.size(); entity++)
+            if ((flags[entity] & withFlags) == withFlags)
+                ids.push_back(objectIds[entity]);
+    }
+
+private:
+    vector<Model> models;
+
+    // components, indexed by entity
+    vector<unsigned int>  nodes;
+    vector<unsigned int>  modelIndices;
+    vector<unsigned char> passes;
+    vector<float>         brightness;
+    vector<unsigned int>  objectIds;
+    vector<unsigned char> flags;
+
+    unsigned int castersVersion = 0;
+    // one list per job slice, kept between frames so recording does not allocate
+    vector<DrawList> drawLists;
+};
+
+EntityStore sceneEntities;
+#endif
@@ -2,6 +2,10 @@
 #define FIGURES_H
 
 #include <model.h>
+#include <bvh.h>
+#include <scenegraph.h>
+#include <entities.h>
+#include <jobs.h>
 
 #include <string>
 #include <fstream>
@@ -20,166 +24,90 @@ const float SQUARE_SIZE = 0.78f;
 
 glm::vec3 STARTING_POS = glm::vec3(3.5f * SQUARE_SIZE, 0, -SQUARE_SIZE);
 
-class Figure : public Model {
-public:
-
+// One kind of piece: its model, the offset of the model within a square and the squares it starts on.
+struct FigureType {
+    string path;
+    glm::vec3 position;
     vector<glm::vec2> positionsOnBoard;
-
-    Figure() {}
-
-    Figure(string const& path,
-        glm::vec3 position,
-        vector<glm::vec2> positionsOnBoard,
-        float scale = 1.0f,
-        glm::vec3 rotation = glm::vec3(0.0f)) : Model(path, position, scale, rotation) {
-        this->positionsOnBoard = positionsOnBoard;
-    }
-
-    void Draw(Shader& shader, glm::vec3 rotation = glm::vec3(0)) {
-        for (auto positionOnBoard : positionsOnBoard)
-            Model::Draw(shader, GetSquareCoord(positionOnBoard), rotation);
-    }
+    glm::vec3 rotation;
 };
 
 
+// Loads the board and the pieces into the scene entities. The board node is the center of the
+// board, the squares are its children and every piece is placed below its square.
 class Figureset {
 public:
 	const string pathToModels;
 
-    Figure bishopBlack, kingBlack, pawnBlack, knightBlack, queenBlack, rookBlack;
-    Figure bishopWhite, kingWhite, pawnWhite, knightWhite, queenWhite, rookWhite;
-    Model board;
+    unsigned int boardNode = 0;
+    unsigned int squareNodes[8][8];
+    unsigned int boardEntity = 0;
+    vector<unsigned int> pieceEntities;
 
     bool FiguresLoaded = false;
 
 	Figureset(string const& path) : pathToModels(path) {
-        board = Model(
+        boardNode = sceneGraph.AddNode(SCENE_ROOT, STARTING_POS);
+        for (int x = 0; x < 8; x++)
+            for (int y = 0; y < 8; y++)
+                squareNodes[x][y] = sceneGraph.AddNode(boardNode, GetSquareCoord(glm::vec2(x, y)) - STARTING_POS);
+
+        unsigned int board = sceneEntities.AddModel(Model(
             pathToModels + "board/board.obj",
-            STARTING_POS + glm::vec3(0.0f, 0.0f, 0.0f),
+            glm::vec3(0.0f, 0.0f, 0.0f),
             BOARD_SCALE
-        );
+        ));
+        boardEntity = sceneEntities.Spawn(board, boardNode, PASS_OPAQUE, ENTITY_ENABLED | ENTITY_CASTS_SHADOW);
 	}
 
-    void Draw(Shader& shader) {
-        DrawBoard(shader);
-        DrawFigures(shader);
-    }
-
-	void DrawBoard(Shader& shader) {
-        board.Draw(shader);
-	}
-
-    void DrawFigures(Shader& shader) {
-        if (!FiguresLoaded) return;
-        bishopBlack.Draw(shader); 
-        bishopBlack.Draw(shader); 
-        kingBlack.Draw(shader); 
-        pawnBlack.Draw(shader); 
-        knightBlack.Draw(shader); 
-        queenBlack.Draw(shader); 
-        rookBlack.Draw(shader);
-
-        bishopWhite.Draw(shader); 
-        bishopWhite.Draw(shader); 
-        kingWhite.Draw(shader); 
-        pawnWhite.Draw(shader); 
-        knightWhite.Draw(shader); 
-        queenWhite.Draw(shader); 
-        rookWhite.Draw(shader);
-    }
-
 	void LoadFigures() {
 
         if (FiguresLoaded) return;
 
         FiguresLoaded = true;
-        
-        // black figures
-        bishopBlack = Figure(
-            pathToModels + "black/bishop/bishop.obj",
-            glm::vec3(0, 0.12f, 3.85f),
-            {glm::vec2(5, 0), glm::vec2(2, 0)},
-            PIECE_SCALE,
-            glm::vec3(0, 180, 0)
-        );
-        kingBlack = Figure(
-            pathToModels + "black/king/king.obj",
-            glm::vec3(0.0, 0.12f, 5.225f),
-            {glm::vec2(4,0)},
-            PIECE_SCALE,
-            glm::vec3(0, 180, 0)
-        );
-        pawnBlack = Figure(
-            pathToModels + "black/pawn/pawn.obj",
-            glm::vec3(0, 0.12f, 1.9f),
-            { glm::vec2(0, 1), glm::vec2(1, 1), glm::vec2(2, 1), glm::vec2(3, 1), 
-              glm::vec2(4, 1), glm::vec2(5, 1), glm::vec2(6, 1), glm::vec2(7, 1)},
-            PIECE_SCALE,
-            glm::vec3(0, 180, 0)
-        );
-        knightBlack = Figure(
-            pathToModels + "black/knight/knight.obj",
-            glm::vec3(0, 0.12f, 3.2f),
-            { glm::vec2(1, 0), glm::vec2(6, 0) },
-            PIECE_SCALE,
-            glm::vec3(0, 180, 0)
-        );
-        queenBlack = Figure(
-            pathToModels + "black/queen/queen.obj",
-            glm::vec3(0, 0.12f, 4.52f),
-            { glm::vec2(3, 0) },
-            PIECE_SCALE,
-            glm::vec3(0, 180, 0)
-        );
-        rookBlack = Figure(
-            pathToModels + "black/rook/rook.obj",
-            glm::vec3(0, 0.12f, 2.55f),
-            { glm::vec2(0, 0), glm::vec2(7, 0) },
-            PIECE_SCALE,
-            glm::vec3(0, 180, 0)
-        );
-
-        // white figures
-        bishopWhite = Figure(
-            pathToModels + "white/bishop/bishop.obj",
-            glm::vec3(0, 0.12f, 0.0f),
-            { glm::vec2(5, 7), glm::vec2(2, 7) },
-            PIECE_SCALE
-        );
-        kingWhite = Figure(
-            pathToModels + "white/king/king.obj",
-            glm::vec3(0.0, 0.12f, -1.4f),
-            { glm::vec2(4, 7) },
-            PIECE_SCALE
-        );
-        pawnWhite = Figure(
-            pathToModels + "white/pawn/pawn.obj",
-            glm::vec3(0, 0.12f, 1.9f),
-            { glm::vec2(0, 6), glm::vec2(1, 6), glm::vec2(2, 6), glm::vec2(3, 6),
-              glm::vec2(4, 6), glm::vec2(5, 6), glm::vec2(6, 6), glm::vec2(7, 6) },
-            PIECE_SCALE
-        );
-        knightWhite = Figure(
-            pathToModels + "white/knight/knight.obj",
-            glm::vec3(0, 0.12f, 0.6f),
-            { glm::vec2(1, 7), glm::vec2(6, 7) },
-            PIECE_SCALE
-        );
-        queenWhite = Figure(
-            pathToModels + "white/queen/queen.obj",
-            glm::vec3(0, 0.12f, -0.68f),
-            { glm::vec2(3, 7) },
-            PIECE_SCALE
-        );
-        rookWhite = Figure(
-            pathToModels + "white/rook/rook.obj",
-            glm::vec3(0, 0.12f, 1.28),
-            { glm::vec2(0, 7), glm::vec2(7, 7) },
-            PIECE_SCALE
-        );
-	}
-private:
 
+        const glm::vec3 black = glm::vec3(0, 180, 0);
+        const glm::vec3 white = glm::vec3(0.0f);
+        const FigureType types[] = {
+            // black figures
+            { "black/bishop/bishop.obj", glm::vec3(0, 0.12f, 3.85f),  { glm::vec2(5, 0), glm::vec2(2, 0) }, black },
+            { "black/king/king.obj",     glm::vec3(0.0, 0.12f, 5.225f), { glm::vec2(4, 0) }, black },
+            { "black/pawn/pawn.obj",     glm::vec3(0, 0.12f, 1.9f),
+              { glm::vec2(0, 1), glm::vec2(1, 1), glm::vec2(2, 1), glm::vec2(3, 1),
+                glm::vec2(4, 1), glm::vec2(5, 1), glm::vec2(6, 1), glm::vec2(7, 1) }, black },
+            { "black/knight/knight.obj", glm::vec3(0, 0.12f, 3.2f),   { glm::vec2(1, 0), glm::vec2(6, 0) }, black },
+            { "black/queen/queen.obj",   glm::vec3(0, 0.12f, 4.52f),  { glm::vec2(3, 0) }, black },
+            { "black/rook/rook.obj",     glm::vec3(0, 0.12f, 2.55f),  { glm::vec2(0, 0), glm::vec2(7, 0) }, black },
+
+            // white figures
+            { "white/bishop/bishop.obj", glm::vec3(0, 0.12f, 0.0f),   { glm::vec2(5, 7), glm::vec2(2, 7) }, white },
+            { "white/king/king.obj",     glm::vec3(0.0, 0.12f, -1.4f), { glm::vec2(4, 7) }, white },
+            { "white/pawn/pawn.obj",     glm::vec3(0, 0.12f, 1.9f),
+              { glm::vec2(0, 6), glm::vec2(1, 6), glm::vec2(2, 6), glm::vec2(3, 6),
+                glm::vec2(4, 6), glm::vec2(5, 6), glm::vec2(6, 6), glm::vec2(7, 6) }, white },
+            { "white/knight/knight.obj", glm::vec3(0, 0.12f, 0.6f),   { glm::vec2(1, 7), glm::vec2(6, 7) }, white },
+            { "white/queen/queen.obj",   glm::vec3(0, 0.12f, -0.68f), { glm::vec2(3, 7) }, white },
+            { "white/rook/rook.obj",     glm::vec3(0, 0.12f, 1.28),   { glm::vec2(0, 7), glm::vec2(7, 7) }, white }
+        };
+
+        // the files are imported and their textures decoded by jobs, GL objects are created here
+        const unsigned int typeCount = sizeof(types) / sizeof(types[0]);
+        vector<Model> loaded(typeCount);
+        jobSystem.ParallelFor(typeCount, 1, [&](unsigned int begin, unsigned int end) {
+            for (unsigned int i = begin; i < end; i++)
+                loaded[i] = Model(pathToModels + types[i].path, types[i].position, PIECE_SCALE, types[i].rotation, false, LOAD_LATER);
+        });
+
+        for (unsigned int i = 0; i < typeCount; i++)
+        {
+            const FigureType& type = types[i];
+            loaded[i].Upload();
+            unsigned int model = sceneEntities.AddModel(loaded[i]);
+            for (auto positionOnBoard : type.positionsOnBoard)
+                pieceEntities.push_back(sceneEntities.Spawn(model, squareNodes[(int)positionOnBoard.x][(int)positionOnBoard.y],
+                    PASS_OPAQUE, ENTITY_ENABLED | ENTITY_CASTS_SHADOW | ENTITY_OCCLUDEE));
+        }
+	}
 };
 
 glm::vec3 GetSquareCoord(glm::vec2 coord) {
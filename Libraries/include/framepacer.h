@@ -0,0 +1,107 @@
+#ifndef FRAMEPACER_H
+#define FRAMEPACER_H
+
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <thread>
+using namespace std;
+
+// shorter waits are spun, sleeps overshoot by up to a scheduler tick
+const double FRAME_PACER_SPIN_S = 0.002;
+// just in time frames aim to be finished this long before the vertical blank
+const double FRAME_PACER_SAFETY_S = 0.0015;
+// share of the measured slack taken off the sampling lead per frame
+const double FRAME_PACER_GAIN = 0.1;
+// added to the sampling lead when a frame missed the blank it was sampled for
+const double FRAME_PACER_MISS_BACKOFF_S = 0.002;
+
+// Decides when the main thread samples the input of the next frame. With a target frame rate
+// frames start one interval apart, the wait sleeps most of the interval and spins the rest.
+// Just in time, with vsync, the input is sampled only a lead before the vertical blank the frame
+// is meant for. The lead starts at a whole refresh and follows the time finished frames waited
+// for the blank, a missed blank pushes it back out. Times are in seconds of glfwGetTime.
+class FramePacer
+{
+public:
+    bool VSync = true;
+    float TargetFps = 0.0f;  // 0 does not limit
+    bool JustInTime = false;
+
+    // sets the swap interval of the current context and reads the refresh rate of the monitor
+    void Init()
+    {
+        glfwSwapInterval(VSync ? 1 : 0);
+        const GLFWvidmode* mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+        if (mode != NULL && mode->refreshRate > 0)
+            refresh = 1.0 / mode->refreshRate;
+        lead = refresh;
+    }
+
+    // when to sample the input of the next frame, targetPresent gets the blank it is sampled for
+    // or 0 when the frame is not paced just in time
+    double NextSample(double now, float& targetPresent)
+    {
+        lock_guard<mutex> lock(stateMutex);
+        targetPresent = 0.0f;
+        if (JustInTime && VSync)
+        {
+            // the first blank after the last present that can still be made with the current lead
+            double present = lastPresent + Interval();
+            if (present - lead < now)
+                present += std::ceil((now + lead - present) / refresh) * refresh;
+            targetPresent = (float)present;
+            return present - lead;
+        }
+        if (TargetFps <= 0)
+            return now;
+        // a frame that started late restarts the cadence instead of rushing the next ones
+        frameStart = std::max(frameStart + Interval(), now);
+        return frameStart;
+    }
+
+    // sleeps until shortly before the deadline while handling window events, then spins
+    void WaitUntil(double deadline)
+    {
+        double remaining;
+        while ((remaining = deadline - glfwGetTime()) > FRAME_PACER_SPIN_S)
+            glfwWaitEventsTimeout(remaining - FRAME_PACER_SPIN_S);
+        while (glfwGetTime() < deadline)
+            this_thread::yield();
+    }
+
+    // called by the thread presenting, ready is when the GPU finished the frame before its swap
+    void Presented(float targetPresent, double ready, double present)
+    {
+        lock_guard<mutex> lock(stateMutex);
+        lastPresent = present;
+        if (targetPresent <= 0) return;
+
+        if (present - targetPresent > 0.5 * refresh)
+            lead += FRAME_PACER_MISS_BACKOFF_S;
+        else
+            lead -= FRAME_PACER_GAIN * (present - ready - FRAME_PACER_SAFETY_S);
+        lead = std::min(std::max(lead, FRAME_PACER_SAFETY_S), Interval());
+    }
+
+private:
+    mutex stateMutex;
+    double refresh = 1.0 / 60.0;
+    double lead = 1.0 / 60.0;
+    double lastPresent = 0.0;
+    double frameStart = 0.0;
+
+    // time between frames, with vsync a whole number of refreshes
+    double Interval() const
+    {
+        double interval = TargetFps > 0 ? 1.0 / TargetFps : 0.0;
+        if (VSync)
+            interval = std::max(1.0, std::ceil(interval / refresh - 0.01)) * refresh;
+        return interval;
+    }
+};
+
+FramePacer framePacer;
+#endif
@@ -0,0 +1,108 @@
+#ifndef FRAMESNAPSHOT_H
+#define FRAMESNAPSHOT_H
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+using namespace std;
+
+// Everything the render thread needs to know about one simulated frame. The main thread fills a
+// snapshot after polling the input and advancing the simulation, the render thread draws it
+// without reading any of the main thread's state.
+struct FrameSnapshot {
+    float time = 0;               // when the input of this frame was sampled
+    float targetPresent = 0;      // vertical blank the pacer sampled the input for, 0 if not paced just in time
+    int framebufferWidth = 0;
+    int framebufferHeight = 0;
+
+    // camera the frame is seen through
+    glm::mat4 view = glm::mat4(1.0f);
+    glm::mat4 projection = glm::mat4(1.0f);
+    glm::vec3 viewPosition = glm::vec3(0.0f);
+
+    // spotlight rig relative to the board, the extra rotation of its models and the light it casts
+    glm::vec3 spotlightOffset = glm::vec3(0.0f);
+    glm::vec3 spotlightRotation = glm::vec3(0.0f);
+    glm::vec3 spotlightPosition = glm::vec3(0.0f);
+    glm::vec3 spotlightDirection = glm::vec3(0.0f);
+    bool spotlightActive = false;
+    float lampBrightness = 1.0f;  // 0 - 1
+
+    // renderer settings
+    int shading = 0;
+    unsigned int shaderFeatures = 0;
+    bool blinn = true;
+    int fogLevel = 0;
+    bool occlusionCulling = true;
+    bool depthPrepass = false;
+    bool shadows = true;
+    bool venueLamps = false;
+    bool antialiasing = false;
+    bool justInTime = false;
+    bool printStats = false;
+    unsigned int settingsVersion = 0; // changes with every setting printed in the statistics
+
+    // true if drawing the other snapshot gives the same image, times and statistics do not count
+    bool SameImage(const FrameSnapshot& other) const
+    {
+        return framebufferWidth == other.framebufferWidth && framebufferHeight == other.framebufferHeight
+            && view == other.view && projection == other.projection && viewPosition == other.viewPosition
+            && spotlightOffset == other.spotlightOffset && spotlightRotation == other.spotlightRotation
+            && spotlightPosition == other.spotlightPosition && spotlightDirection == other.spotlightDirection
+            && spotlightActive == other.spotlightActive && lampBrightness == other.lampBrightness
+            && shading == other.shading && shaderFeatures == other.shaderFeatures && blinn == other.blinn
+            && fogLevel == other.fogLevel && occlusionCulling == other.occlusionCulling
+            && depthPrepass == other.depthPrepass && shadows == other.shadows
+            && venueLamps == other.venueLamps && antialiasing == other.antialiasing;
+    }
+};
+
+const unsigned int TRIPLE_BUFFER_FRESH = 4;
+
+// Single producer, single consumer hand-over of the newest value without locks. The producer
+// writes its back slot and swaps it with the middle one, the consumer swaps its front slot with
+// the middle one when something new was published. Neither side ever waits for the other and
+// the consumer always gets the latest complete value, older unread ones are dropped.
+template<typename T>
+class TripleBuffer
+{
+public:
+    // slot the producer fills next, owned by the producer until Publish
+    T& Back()
+    {
+        return slots[back];
+    }
+
+    void Publish()
+    {
+        back = middle.exchange(back | TRIPLE_BUFFER_FRESH, memory_order_acq_rel) & ~TRIPLE_BUFFER_FRESH;
+    }
+
+    // takes the newest published value, false if nothing was published since the last call
+    bool Acquire()
+    {
+        if ((middle.load(memory_order_relaxed) & TRIPLE_BUFFER_FRESH) == 0)
+            return false;
+        front = middle.exchange(front, memory_order_acq_rel) & ~TRIPLE_BUFFER_FRESH;
+        return true;
+    }
+
+    // something was published since the last Acquire
+    bool HasNew() const
+    {
+        return (middle.load(memory_order_relaxed) & TRIPLE_BUFFER_FRESH) != 0;
+    }
+
+    // value taken by the last Acquire, owned by the consumer until the next one
+    const T& Front() const
+    {
+        return slots[front];
+    }
+
+private:
+    T slots[3];
+    unsigned int back = 0;
+    unsigned int front = 1;
+    atomic<unsigned int> middle{ 2 };
+};
+#endif
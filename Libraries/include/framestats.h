@@ -0,0 +1,167 @@
+#ifndef FRAMESTATS_H
+#define FRAMESTATS_H
+
+#include <renderqueue.h>
+#include <glstate.h>
+#include <bvh.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+const float FRAME_STATS_REPORT_INTERVAL_S = 1.0f;
+const int FRAME_STATS_MAX_TIMINGS = 16;
+
+// Collects per-frame counters and prints their averages once per report interval.
+// The same numbers are accumulated over the whole run for the benchmark summary.
+class FrameStats
+{
+public:
+    bool Enabled = false;
+    // renderer settings the numbers were measured with, printed in front of every report
+    string Config;
+
+    void AddFrame(float deltaTime, const RenderQueueStats& queueStats, const GLStateStats& stateStats, const CullStats& cullStats)
+    {
+        Counters frame;
+        frame.frames = 1;
+        frame.frameTime = deltaTime;
+        frame.frameTimeSquares = deltaTime * deltaTime;
+        frame.frameTimeMax = deltaTime;
+        frame.drawCalls = queueStats.drawCalls;
+        frame.triangles = queueStats.triangles;
+        frame.stateChangesSubmitted = queueStats.stateChangesSubmitted;
+        frame.stateChangesExecuted = queueStats.stateChangesExecuted;
+        frame.glCallsIssued = stateStats.callsIssued;
+        frame.glCallsSkipped = stateStats.callsSkipped;
+        frame.objectsVisible = cullStats.visible;
+        frame.objectsCulled = cullStats.culled;
+        frame.objectsOccluded = cullStats.occluded;
+
+        interval.Add(frame);
+        total.Add(frame);
+    }
+
+    // GPU or CPU time of a named pass in this frame, names must be string literals
+    void AddTiming(const char* name, float ms)
+    {
+        int index = TimingIndex(name);
+        if (index < 0) return;
+        interval.timings[index] += ms;
+        interval.timingFrames[index]++;
+        total.timings[index] += ms;
+        total.timingFrames[index]++;
+    }
+
+    void Report(float currentTime)
+    {
+        if (currentTime - lastReportTime < FRAME_STATS_REPORT_INTERVAL_S || interval.frames == 0)
+            return;
+
+        if (Enabled)
+            Print("FRAME::STATS", interval);
+        interval = Counters();
+        lastReportTime = currentTime;
+    }
+
+    // averages over every frame since start, used as the benchmark result
+    void PrintSummary()
+    {
+        if (total.frames == 0) return;
+        Print("BENCHMARK::SUMMARY", total);
+    }
+
+private:
+    struct Counters {
+        unsigned int frames = 0;
+        float frameTime = 0;
+        // frame pacing: spread and worst case of the intervals between presented frames
+        double frameTimeSquares = 0;
+        float frameTimeMax = 0;
+        unsigned long long drawCalls = 0;
+        unsigned long long triangles = 0;
+        unsigned long long stateChangesSubmitted = 0;
+        unsigned long long stateChangesExecuted = 0;
+        unsigned long long glCallsIssued = 0;
+        unsigned long long glCallsSkipped = 0;
+        unsigned long long objectsVisible = 0;
+        unsigned long long objectsCulled = 0;
+        unsigned long long objectsOccluded = 0;
+        float timings[FRAME_STATS_MAX_TIMINGS] = {};
+        unsigned int timingFrames[FRAME_STATS_MAX_TIMINGS] = {};
+
+        void Add(const Counters& other)
+        {
+            frames += other.frames;
+            frameTime += other.frameTime;
+            frameTimeSquares += other.frameTimeSquares;
+            frameTimeMax = std::max(frameTimeMax, other.frameTimeMax);
+            drawCalls += other.drawCalls;
+            triangles += other.triangles;
+            stateChangesSubmitted += other.stateChangesSubmitted;
+            stateChangesExecuted += other.stateChangesExecuted;
+            glCallsIssued += other.glCallsIssued;
+            glCallsSkipped += other.glCallsSkipped;
+            objectsVisible += other.objectsVisible;
+            objectsCulled += other.objectsCulled;
+            objectsOccluded += other.objectsOccluded;
+        }
+    };
+
+    float lastReportTime = 0;
+    Counters interval;
+    Counters total;
+    const char* timingNames[FRAME_STATS_MAX_TIMINGS] = {};
+
+    int TimingIndex(const char* name)
+    {
+        for (int i = 0; i < FRAME_STATS_MAX_TIMINGS; i++)
+        {
+            if (timingNames[i] == nullptr)
+            {
+                timingNames[i] = name;
+                return i;
+            }
+            if (timingNames[i] == name || std::strcmp(timingNames[i], name) == 0)
+                return i;
+        }
+        return -1;
+    }
+
+    // standard deviation of the frame time, zero when every frame took equally long
+    static float FrameTimeDeviation(const Counters& counters)
+    {
+        double mean = counters.frameTime / counters.frames;
+        return (float)std::sqrt(std::max(0.0, counters.frameTimeSquares / counters.frames - mean * mean));
+    }
+
+    void Print(const char* title, const Counters& counters) const
+    {
+        long long frames = counters.frames;
+        std::cout << title;
+        if (!Config.empty())
+            std::cout << " [" << Config << "]";
+        std::cout
+            << " fps: " << counters.frames / counters.frameTime
+            << " ms: " << 1000.0f * counters.frameTime / counters.frames
+            << " (jitter: " << 1000.0f * FrameTimeDeviation(counters) << " max: " << 1000.0f * counters.frameTimeMax << ")"
+            << " draws: " << counters.drawCalls / frames
+            << " triangles: " << counters.triangles / frames
+            << " state changes: " << counters.stateChangesExecuted / frames
+            << " (saved by sorting: " << ((long long)counters.stateChangesSubmitted - (long long)counters.stateChangesExecuted) / frames << ")"
+            << " gl binds: " << counters.glCallsIssued / frames
+            << " (redundant skipped: " << counters.glCallsSkipped / frames << ")"
+            << " objects visible: " << counters.objectsVisible / frames
+            << " culled: " << counters.objectsCulled / frames
+            << " occluded: " << counters.objectsOccluded / frames;
+        for (int i = 0; i < FRAME_STATS_MAX_TIMINGS && timingNames[i] != nullptr; i++)
+        {
+            if (counters.timingFrames[i] > 0)
+                std::cout << " " << timingNames[i] << ": " << counters.timings[i] / counters.timingFrames[i] << " ms";
+        }
+        std::cout << std::endl;
+    }
+};
+#endif
@@ -0,0 +1,236 @@
+#ifndef GLSTATE_H
+#define GLSTATE_H
+
+#include <glad/glad.h>
+
+const unsigned int GL_STATE_TEXTURE_UNITS = 32;
+const unsigned int GL_STATE_UNIFORM_BINDINGS = 4;
+const unsigned int GL_STATE_UNKNOWN = 0xFFFFFFFFu;
+
+struct GLStateStats {
+    unsigned int callsIssued;
+    unsigned int callsSkipped;
+};
+
+// Thin cache in front of the GL binding calls. Every bind goes through here, so a call
+// that would not change the current state never reaches the driver.
+// Code that changes this state directly has to call Invalidate() afterwards.
+class GLState
+{
+public:
+    GLStateStats stats;
+    // framebuffer the scene is drawn into, passes rendering into their own targets bind it again when done
+    unsigned int SceneFramebuffer = 0;
+
+    GLState()
+    {
+        Invalidate();
+        stats = GLStateStats();
+    }
+
+    void Invalidate()
+    {
+        program = GL_STATE_UNKNOWN;
+        vertexArray = GL_STATE_UNKNOWN;
+        activeUnit = GL_STATE_UNKNOWN;
+        drawFramebuffer = GL_STATE_UNKNOWN;
+        readFramebuffer = GL_STATE_UNKNOWN;
+        depthFunc = GL_STATE_UNKNOWN;
+        depthMask = MASK_UNKNOWN;
+        colorMask = MASK_UNKNOWN;
+        for (unsigned int unit = 0; unit < GL_STATE_TEXTURE_UNITS; unit++)
+            for (unsigned int target = 0; target < TARGET_COUNT; target++)
+                textures[unit][target] = GL_STATE_UNKNOWN;
+        for (unsigned int cap = 0; cap < CAPABILITY_COUNT; cap++)
+            capabilities[cap] = CAP_UNKNOWN;
+        for (unsigned int index = 0; index < GL_STATE_UNIFORM_BINDINGS; index++)
+            uniformRanges[index] = UniformRange{ GL_STATE_UNKNOWN, 0, 0 };
+    }
+
+    void ResetStats()
+    {
+        stats = GLStateStats();
+    }
+
+    void UseProgram(unsigned int id)
+    {
+        if (program == id) { stats.callsSkipped++; return; }
+        program = id;
+        stats.callsIssued++;
+        glUseProgram(id);
+    }
+
+    void BindVertexArray(unsigned int id)
+    {
+        if (vertexArray == id) { stats.callsSkipped++; return; }
+        vertexArray = id;
+        stats.callsIssued++;
+        glBindVertexArray(id);
+    }
+
+    void ActiveTexture(GLenum unit)
+    {
+        if (activeUnit == unit) { stats.callsSkipped++; return; }
+        activeUnit = unit;
+        stats.callsIssued++;
+        glActiveTexture(unit);
+    }
+
+    // binds to the currently active unit
+    void BindTexture(GLenum target, unsigned int id)
+    {
+        int slot = TargetSlot(target);
+        unsigned int unit = activeUnit - GL_TEXTURE0;
+        if (slot < 0 || activeUnit == GL_STATE_UNKNOWN || unit >= GL_STATE_TEXTURE_UNITS)
+        {
+            stats.callsIssued++;
+            glBindTexture(target, id);
+            return;
+        }
+        if (textures[unit][slot] == id) { stats.callsSkipped++; return; }
+        textures[unit][slot] = id;
+        stats.callsIssued++;
+        glBindTexture(target, id);
+    }
+
+    // binds to the given unit, the unit is only activated when the binding has to change
+    void BindTexture(unsigned int unit, GLenum target, unsigned int id)
+    {
+        int slot = TargetSlot(target);
+        if (slot >= 0 && unit < GL_STATE_TEXTURE_UNITS && textures[unit][slot] == id) { stats.callsSkipped++; return; }
+        ActiveTexture(GL_TEXTURE0 + unit);
+        BindTexture(target, id);
+    }
+
+    void Enable(GLenum cap)
+    {
+        SetCapability(cap, true);
+    }
+
+    void Disable(GLenum cap)
+    {
+        SetCapability(cap, false);
+    }
+
+    // GL_FRAMEBUFFER binds both the draw and the read framebuffer
+    void BindFramebuffer(GLenum target, unsigned int id)
+    {
+        bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+        bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+        if ((!draw || drawFramebuffer == id) && (!read || readFramebuffer == id)) { stats.callsSkipped++; return; }
+        if (draw) drawFramebuffer = id;
+        if (read) readFramebuffer = id;
+        stats.callsIssued++;
+        glBindFramebuffer(target, id);
+    }
+
+    // binds a range of a buffer to an indexed uniform block binding point
+    void BindUniformRange(unsigned int index, unsigned int buffer, unsigned int offset, unsigned int size)
+    {
+        if (index < GL_STATE_UNIFORM_BINDINGS)
+        {
+            UniformRange& range = uniformRanges[index];
+            if (range.buffer == buffer && range.offset == offset && range.size == size) { stats.callsSkipped++; return; }
+            range = UniformRange{ buffer, offset, size };
+        }
+        stats.callsIssued++;
+        glBindBufferRange(GL_UNIFORM_BUFFER, index, buffer, offset, size);
+    }
+
+    void DepthFunc(GLenum func)
+    {
+        if (depthFunc == func) { stats.callsSkipped++; return; }
+        depthFunc = func;
+        stats.callsIssued++;
+        glDepthFunc(func);
+    }
+
+    void DepthMask(bool write)
+    {
+        int mask = write ? MASK_WRITE : MASK_NONE;
+        if (depthMask == mask) { stats.callsSkipped++; return; }
+        depthMask = mask;
+        stats.callsIssued++;
+        glDepthMask(write ? GL_TRUE : GL_FALSE);
+    }
+
+    // all four channels at once, that is the only way the renderer masks color
+    void ColorMask(bool write)
+    {
+        int mask = write ? MASK_WRITE : MASK_NONE;
+        if (colorMask == mask) { stats.callsSkipped++; return; }
+        colorMask = mask;
+        stats.callsIssued++;
+        GLboolean value = write ? GL_TRUE : GL_FALSE;
+        glColorMask(value, value, value, value);
+    }
+
+private:
+    enum { TARGET_COUNT = 4, CAPABILITY_COUNT = 9 };
+    enum { CAP_UNKNOWN = -1, CAP_DISABLED = 0, CAP_ENABLED = 1 };
+    enum { MASK_UNKNOWN = -1, MASK_NONE = 0, MASK_WRITE = 1 };
+
+    struct UniformRange {
+        unsigned int buffer;
+        unsigned int offset;
+        unsigned int size;
+    };
+
+    unsigned int program;
+    unsigned int vertexArray;
+    unsigned int activeUnit;
+    unsigned int drawFramebuffer;
+    unsigned int readFramebuffer;
+    unsigned int depthFunc;
+    int depthMask;
+    int colorMask;
+    unsigned int textures[GL_STATE_TEXTURE_UNITS][TARGET_COUNT];
+    int capabilities[CAPABILITY_COUNT];
+    UniformRange uniformRanges[GL_STATE_UNIFORM_BINDINGS];
+
+    static int TargetSlot(GLenum target)
+    {
+        switch (target)
+        {
+        case GL_TEXTURE_2D:             return 0;
+        case GL_TEXTURE_CUBE_MAP:       return 1;
+        case GL_TEXTURE_2D_MULTISAMPLE: return 2;
+        case GL_TEXTURE_BUFFER:         return 3;
+        default:                        return -1;
+        }
+    }
+
+    static int CapabilitySlot(GLenum cap)
+    {
+        switch (cap)
+        {
+        case GL_DEPTH_TEST:          return 0;
+        case GL_CULL_FACE:           return 1;
+        case GL_BLEND:               return 2;
+        case GL_STENCIL_TEST:        return 3;
+        case GL_SCISSOR_TEST:        return 4;
+        case GL_MULTISAMPLE:         return 5;
+        case GL_POLYGON_OFFSET_FILL: return 6;
+        case GL_FRAMEBUFFER_SRGB:    return 7;
+        case GL_DEPTH_CLAMP:         return 8;
+        default:                     return -1;
+        }
+    }
+
+    void SetCapability(GLenum cap, bool enabled)
+    {
+        int slot = CapabilitySlot(cap);
+        int state = enabled ? CAP_ENABLED : CAP_DISABLED;
+        if (slot >= 0 && capabilities[slot] == state) { stats.callsSkipped++; return; }
+        if (slot >= 0)
+            capabilities[slot] = state;
+        stats.callsIssued++;
+        if (enabled)
+            glEnable(cap);
+        else
+            glDisable(cap);
+    }
+};
+
+GLState glState;
+#endif
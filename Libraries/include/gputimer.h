@@ -0,0 +1,64 @@
+#ifndef GPUTIMER_H
+#define GPUTIMER_H
+
+#include <glad/glad.h>
+
+// frames a timer query may stay in flight before its result is read
+const int GPU_TIMER_LATENCY = 3;
+
+// Measures the GPU time of a pass with GL_TIME_ELAPSED queries. Results are read a few frames late
+// and only when available, so timing never stalls the pipeline. Timers must not be nested.
+class GpuTimer
+{
+public:
+    GpuTimer()
+    {
+        current = 0;
+        lastMs = 0.0f;
+        initialized = false;
+    }
+
+    void Begin()
+    {
+        if (!initialized)
+        {
+            glGenQueries(GPU_TIMER_LATENCY, queries);
+            for (int i = 0; i < GPU_TIMER_LATENCY; i++)
+                issued[i] = false;
+            initialized = true;
+        }
+        if (issued[current])
+        {
+            GLuint available = 0;
+            glGetQueryObjectuiv(queries[current], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available)
+            {
+                GLuint64 elapsedNs = 0;
+                glGetQueryObjectui64v(queries[current], GL_QUERY_RESULT, &elapsedNs);
+                lastMs = elapsedNs / 1000000.0f;
+            }
+        }
+        glBeginQuery(GL_TIME_ELAPSED, queries[current]);
+    }
+
+    void End()
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        issued[current] = true;
+        current = (current + 1) % GPU_TIMER_LATENCY;
+    }
+
+    // most recent finished measurement
+    float LastMs() const
+    {
+        return lastMs;
+    }
+
+private:
+    unsigned int queries[GPU_TIMER_LATENCY];
+    bool issued[GPU_TIMER_LATENCY];
+    int current;
+    float lastMs;
+    bool initialized;
+};
+#endif
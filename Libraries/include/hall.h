@@ -0,0 +1,192 @@
+#ifndef HALL_H
+#define HALL_H
+
+#include <glm/glm.hpp>
+
+#include <mesh.h>
+#include <model.h>
+#include <bounds.h>
+#include <entities.h>
+#include <figureset.h>
+#include <renderqueue.h>
+#include <streambuffer.h>
+#include <impostor.h>
+#include <jobs.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+using namespace std;
+
+// distance between the centers of neighbouring boards
+const float HALL_BOARD_SPACING = 9.0f;
+// boards farther from the camera than these distances are drawn with the next coarser level of detail
+const float HALL_LOD_DISTANCES[MESH_LOD_COUNT - 1] = { 12.0f, 30.0f };
+// boards start turning into impostors this far from the camera, over the fade distance
+const float HALL_IMPOSTOR_DISTANCE = 40.0f;
+const float HALL_IMPOSTOR_FADE = 6.0f;
+const unsigned char HALL_BOARD_CULLED = 0xFF;
+const unsigned char HALL_BOARD_IMPOSTOR = 0xFE;
+// boards per culling job
+const unsigned int HALL_JOB_GRAIN = 64;
+
+// Tournament hall: copies of the main board and its pieces on a grid around it, the stress scene
+// for scenes with hundreds of boards. The copies are no entities, the hall only keeps their
+// offsets and bounds and draws them with the models and transforms of the main board's entities.
+// Every frame the boards are culled against the frustum and get a level of detail by their
+// distance in jobs, then each mesh is drawn once per level for all boards of that level with an
+// instanced draw, the board offsets streamed next to the per draw data. Past the impostor
+// distance a board is a single quad showing a pre-rendered view of the main board, in between
+// both are drawn with complementary dither patterns, so the geometry drawn is bounded by the
+// boards within the impostor distance however large the hall is.
+class TournamentHall
+{
+public:
+    bool Impostors = true;
+    unsigned int VisibleBoards = 0;
+
+    // places boardCount - 1 boards around the main one, nearest cells first, and captures the
+    // impostor of the main board, the scene graph has to be up to date
+    void Build(const Figureset& figureset, unsigned int boardCount, const string& shaderDirectory)
+    {
+        entities.clear();
+        entities.push_back(figureset.boardEntity);
+        entities.insert(entities.end(), figureset.pieceEntities.begin(), figureset.pieceEntities.end());
+
+        AABB mainBounds;
+        for (unsigned int entity : entities)
+            mainBounds.Merge(sceneEntities.GetModel(sceneEntities.ModelIndex(entity)).GetWorldBounds(sceneEntities.Node(entity)));
+
+        // a square of cells large enough for every board, sorted by the distance to the main board's cell
+        int radius = (int)std::ceil(std::sqrt((float)boardCount) / 2.0f) + 1;
+        vector<glm::ivec2> cells;
+        for (int z = -radius; z <= radius; z++)
+            for (int x = -radius; x <= radius; x++)
+                cells.push_back(glm::ivec2(x, z));
+        std::stable_sort(cells.begin(), cells.end(), [](const glm::ivec2& a, const glm::ivec2& b) {
+            return a.x * a.x + a.y * a.y < b.x * b.x + b.y * b.y;
+        });
+
+        offsets.clear();
+        bounds.clear();
+        extent = 0.0f;
+        float halfDiagonal = 0.5f * glm::length(mainBounds.max - mainBounds.min);
+        // the first cell is the main board itself
+        for (unsigned int i = 1; i < boardCount && i < cells.size(); i++)
+        {
+            glm::vec3 offset = glm::vec3(cells[i].x, 0.0f, cells[i].y) * HALL_BOARD_SPACING;
+            offsets.push_back(offset);
+            bounds.push_back(AABB(mainBounds.min + offset, mainBounds.max + offset));
+            extent = std::max(extent, glm::length(offset) + halfDiagonal);
+        }
+        lods.resize(offsets.size());
+        fades.resize(offsets.size());
+        if (Impostors)
+            impostor.Capture(entities, mainBounds, shaderDirectory);
+    }
+
+    // boards besides the main one
+    unsigned int Size() const
+    {
+        return (unsigned int)offsets.size();
+    }
+
+    // distance from the main board to the farthest point of the hall
+    float Extent() const
+    {
+        return extent;
+    }
+
+    // queues the visible boards near enough for geometry and collects the impostors, the shader
+    // has to be an instanced variant
+    void Submit(RenderQueue& queue, Shader& shader, const Frustum& frustum)
+    {
+        glm::vec3 viewPos = queue.ViewPosition();
+        bool impostors = Impostors && impostor.Captured();
+        jobSystem.ParallelFor(Size(), HALL_JOB_GRAIN, [&](unsigned int begin, unsigned int end) {
+            for (unsigned int board = begin; board < end; board++)
+            {
+                if (frustum.TestAABB(bounds[board]) == FRUSTUM_OUTSIDE)
+                {
+                    lods[board] = HALL_BOARD_CULLED;
+                    continue;
+                }
+                float distance = glm::length(bounds[board].Center() - viewPos);
+                fades[board] = impostors ? glm::clamp((distance - HALL_IMPOSTOR_DISTANCE) / HALL_IMPOSTOR_FADE, 0.0f, 1.0f) : 0.0f;
+                if (fades[board] >= 1.0f)
+                {
+                    lods[board] = HALL_BOARD_IMPOSTOR;
+                    continue;
+                }
+                unsigned char lod = 0;
+                while (lod < MESH_LOD_COUNT - 1 && distance > HALL_LOD_DISTANCES[lod])
+                    lod++;
+                lods[board] = lod;
+            }
+        });
+
+        // every board holds the same pieces, so the offsets of one level serve all of its meshes
+        VisibleBoards = 0;
+        for (unsigned int lod = 0; lod < MESH_LOD_COUNT; lod++)
+            instances[lod].clear();
+        impostorInstances.clear();
+        for (unsigned int board = 0; board < Size(); board++)
+        {
+            if (lods[board] == HALL_BOARD_CULLED) continue;
+            glm::vec4 instance = glm::vec4(offsets[board], fades[board]);
+            if (lods[board] != HALL_BOARD_IMPOSTOR)
+                instances[lods[board]].push_back(instance);
+            if (fades[board] > 0.0f)
+                impostorInstances.push_back(instance);
+            VisibleBoards++;
+        }
+
+        for (unsigned int lod = 0; lod < MESH_LOD_COUNT; lod++)
+        {
+            for (unsigned int first = 0; first < instances[lod].size(); first += INSTANCE_BATCH)
+            {
+                unsigned int count = std::min((unsigned int)instances[lod].size() - first, INSTANCE_BATCH);
+                unsigned int offset = 0;
+                void* data = streamBuffer.Allocate(count * sizeof(glm::vec4), offset);
+                std::memcpy(data, &instances[lod][first], count * sizeof(glm::vec4));
+                streamBuffer.Flush();
+                for (unsigned int entity : entities)
+                    sceneEntities.GetModel(sceneEntities.ModelIndex(entity)).SubmitInstanced(queue, PASS_OPAQUE, shader,
+                        sceneEntities.Node(entity), lod, offset, count);
+            }
+        }
+    }
+
+    // draws the impostors Submit collected, after the opaque pass, counted with the draws of the queue
+    void DrawImpostors(RenderQueue& queue, Shader& shader)
+    {
+        for (unsigned int first = 0; first < impostorInstances.size(); first += INSTANCE_BATCH)
+        {
+            unsigned int count = std::min((unsigned int)impostorInstances.size() - first, INSTANCE_BATCH);
+            unsigned int offset = 0;
+            void* data = streamBuffer.Allocate(count * sizeof(glm::vec4), offset);
+            std::memcpy(data, &impostorInstances[first], count * sizeof(glm::vec4));
+            streamBuffer.Flush();
+            impostor.Draw(shader, offset, count);
+            queue.stats.drawCalls++;
+            queue.stats.triangles += 2 * count;
+        }
+    }
+
+private:
+    // the board and piece entities of the main board, drawn again on every board of the hall
+    vector<unsigned int> entities;
+    vector<glm::vec3> offsets;
+    vector<AABB> bounds;
+    vector<unsigned char> lods;
+    vector<float> fades;
+    vector<glm::vec4> instances[MESH_LOD_COUNT];
+    vector<glm::vec4> impostorInstances;
+    Impostor impostor;
+    float extent = 0.0f;
+};
+
+TournamentHall tournamentHall;
+#endif
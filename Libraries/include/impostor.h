@@ -0,0 +1,161 @@
+#ifndef IMPOSTOR_H
+#define IMPOSTOR_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <shader.h>
+#include <glstate.h>
+#include <bounds.h>
+#include <entities.h>
+#include <renderqueue.h>
+#include <streambuffer.h>
+
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+const int IMPOSTOR_ATLAS_SIZE = 1024;
+// frames along each side of the atlas
+const int IMPOSTOR_FRAMES = 8;
+// coarser mipmap levels would mix neighbouring frames
+const int IMPOSTOR_MAX_LEVEL = 4;
+const unsigned int IMPOSTOR_ALBEDO_UNIT = 0;
+const unsigned int IMPOSTOR_NORMAL_UNIT = 1;
+
+// Pre-rendered views of a group of entities, drawn far away as one quad instead of their meshes.
+// The atlas holds orthographic views from directions over the upper hemisphere, laid out by the
+// hemi-octahedral mapping, with the albedo and the world space normal of every pixel. Drawing
+// picks the frame nearest to the view direction per instance and lights it like the forward
+// shaders, so a board costs two triangles whatever it holds.
+class Impostor
+{
+public:
+    // renders every frame of the atlas, on the GL thread once the transforms of the entities are final
+    void Capture(const vector<unsigned int>& entities, const AABB& bounds, const string& shaderDirectory)
+    {
+        center = bounds.Center();
+        radius = 0.5f * glm::length(bounds.max - bounds.min);
+
+        albedoTexture = CreateAtlasTexture();
+        normalTexture = CreateAtlasTexture();
+        unsigned int depthBuffer;
+        glGenRenderbuffers(1, &depthBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, IMPOSTOR_ATLAS_SIZE, IMPOSTOR_ATLAS_SIZE);
+        unsigned int framebuffer;
+        glGenFramebuffers(1, &framebuffer);
+        glState.BindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedoTexture, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normalTexture, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+        unsigned int attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+        glDrawBuffers(2, attachments);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::IMPOSTOR::FRAMEBUFFER_INCOMPLETE" << std::endl;
+
+        Shader captureShader((shaderDirectory + "impostor_capture.vert").c_str(), (shaderDirectory + "impostor_capture.frag").c_str());
+        RenderQueue queue;
+        queue.Begin(center);
+        for (unsigned int entity : entities)
+            sceneEntities.GetModel(sceneEntities.ModelIndex(entity)).Submit(queue, PASS_OPAQUE, captureShader, sceneEntities.Node(entity));
+        queue.Sort();
+
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        // the camera stays outside the bounding sphere, the sphere fills the frame
+        glm::mat4 projection = glm::ortho(-radius, radius, -radius, radius, 0.0f, 4.0f * radius);
+        int frameSize = IMPOSTOR_ATLAS_SIZE / IMPOSTOR_FRAMES;
+        streamBuffer.BeginFrame();
+        for (int y = 0; y < IMPOSTOR_FRAMES; y++)
+        {
+            for (int x = 0; x < IMPOSTOR_FRAMES; x++)
+            {
+                glm::vec3 direction = FrameDirection(x, y);
+                captureShader.Use();
+                captureShader.SetMat4("projection", projection);
+                captureShader.SetMat4("view", glm::lookAt(center + 2.0f * radius * direction, center, FrameUp(direction)));
+                glViewport(x * frameSize, y * frameSize, frameSize, frameSize);
+                queue.Execute(PASS_OPAQUE, PASS_OPAQUE);
+            }
+        }
+        streamBuffer.EndFrame();
+
+        glState.BindFramebuffer(GL_FRAMEBUFFER, glState.SceneFramebuffer);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteRenderbuffers(1, &depthBuffer);
+        for (unsigned int texture : { albedoTexture, normalTexture })
+        {
+            glState.BindTexture(0, GL_TEXTURE_2D, texture);
+            glGenerateMipmap(GL_TEXTURE_2D);
+        }
+
+        // the corners of the quad come from gl_VertexID, a core profile still needs a VAO bound
+        glGenVertexArrays(1, &quadVAO);
+    }
+
+    bool Captured() const
+    {
+        return quadVAO != 0;
+    }
+
+    // draws count quads, their offsets and fades are vec4s at instanceOffset in the stream buffer
+    void Draw(Shader& shader, unsigned int instanceOffset, unsigned int count)
+    {
+        shader.Use();
+        shader.SetVec3("impostorCenter", center);
+        shader.SetFloat("impostorRadius", radius);
+        shader.SetFloat("impostorFrames", (float)IMPOSTOR_FRAMES);
+        shader.SetInt("impostorAlbedo", IMPOSTOR_ALBEDO_UNIT);
+        shader.SetInt("impostorNormal", IMPOSTOR_NORMAL_UNIT);
+        glState.BindTexture(IMPOSTOR_ALBEDO_UNIT, GL_TEXTURE_2D, albedoTexture);
+        glState.BindTexture(IMPOSTOR_NORMAL_UNIT, GL_TEXTURE_2D, normalTexture);
+        glState.BindVertexArray(quadVAO);
+        glState.BindUniformRange(INSTANCE_DATA_BINDING, streamBuffer.Buffer(), instanceOffset, INSTANCE_BATCH * sizeof(glm::vec4));
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, count);
+    }
+
+private:
+    unsigned int albedoTexture = 0;
+    unsigned int normalTexture = 0;
+    unsigned int quadVAO = 0;
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = 0.0f;
+
+    // direction the frame in column x and row y was captured from, the inverse of HemiOctEncode in Shaders/impostor.vert
+    static glm::vec3 FrameDirection(int x, int y)
+    {
+        glm::vec2 t = (glm::vec2((float)x, (float)y) + 0.5f) / (float)IMPOSTOR_FRAMES * 2.0f - 1.0f;
+        glm::vec2 p = glm::vec2(t.x + t.y, t.x - t.y) * 0.5f;
+        return glm::normalize(glm::vec3(p.x, 1.0f - std::abs(p.x) - std::abs(p.y), p.y));
+    }
+
+    // up vector of the frame camera, the impostor shader builds the same basis for its quads
+    static glm::vec3 FrameUp(glm::vec3 direction)
+    {
+        return std::abs(direction.y) > 0.999f ? glm::vec3(0.0f, 0.0f, -1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    }
+
+    static unsigned int CreateAtlasTexture()
+    {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        glState.BindTexture(0, GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, IMPOSTOR_ATLAS_SIZE, IMPOSTOR_ATLAS_SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, IMPOSTOR_MAX_LEVEL);
+        return texture;
+    }
+};
+#endif
@@ -0,0 +1,241 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+using namespace std;
+
+class JobCounter;
+
+struct Job {
+    function<void()> task;
+    JobCounter*      counter; // decremented when the job is done, may be null
+};
+
+// Counts the unfinished jobs of a group. Jobs submitted with a group as their dependency are
+// held back until every job of that group is done.
+class JobCounter
+{
+public:
+    bool Done() const
+    {
+        return pending.load() == 0;
+    }
+
+private:
+    friend class JobSystem;
+    atomic<int> pending{ 0 };
+    mutex       lock;
+    vector<Job> continuations;
+};
+
+// Fixed pool of worker threads, each with its own deque of jobs. A worker pops the newest job of
+// its own deque and, when that is empty, steals the oldest job of another one. Threads outside
+// of the pool share one more deque. Waiting on a counter runs jobs instead of blocking, so jobs
+// may wait on the jobs they spawn. Jobs must not touch the GL context, the GL thread only
+// consumes their results.
+class JobSystem
+{
+public:
+    ~JobSystem()
+    {
+        Shutdown();
+    }
+
+    // with zero workers every job runs on the thread that submits or waits for it
+    void Init(unsigned int workerCount)
+    {
+        Shutdown();
+        stop = false;
+        queues.clear();
+        for (unsigned int i = 0; i <= workerCount; i++)
+            queues.push_back(unique_ptr<Queue>(new Queue()));
+        for (unsigned int i = 1; i <= workerCount; i++)
+            workers.push_back(thread(&JobSystem::WorkerLoop, this, i));
+    }
+
+    void Shutdown()
+    {
+        if (workers.empty()) return;
+        {
+            lock_guard<mutex> lock(sleepMutex);
+            stop = true;
+        }
+        wake.notify_all();
+        for (thread& worker : workers)
+            worker.join();
+        workers.clear();
+    }
+
+    unsigned int WorkerCount() const
+    {
+        return (unsigned int)workers.size();
+    }
+
+    void Submit(function<void()> task, JobCounter* counter = nullptr, JobCounter* dependency = nullptr)
+    {
+        if (counter != nullptr)
+            counter->pending++;
+        Job job = { task, counter };
+        if (dependency != nullptr)
+        {
+            lock_guard<mutex> lock(dependency->lock);
+            if (dependency->pending > 0)
+            {
+                dependency->continuations.push_back(job);
+                return;
+            }
+        }
+        Schedule(job);
+    }
+
+    // runs queued jobs until every job of the counter is done
+    void Wait(JobCounter& counter)
+    {
+        while (counter.pending > 0)
+            if (!TryRun(ThreadIndex()))
+                this_thread::yield();
+        // the last job decrements under the lock, once it is released the counter may go away
+        lock_guard<mutex> lock(counter.lock);
+    }
+
+    // calls body(begin, end) for consecutive ranges of at most grain items, the calling thread
+    // takes the first range. Counts up to the grain run inline without touching the queues.
+    template<typename Body>
+    void ParallelFor(unsigned int count, unsigned int grain, const Body& body)
+    {
+        if (count == 0) return;
+        grain = std::max(grain, 1u);
+        if (workers.empty() || count <= grain)
+        {
+            body(0u, count);
+            return;
+        }
+
+        JobCounter counter;
+        for (unsigned int begin = grain; begin < count; begin += grain)
+        {
+            unsigned int end = std::min(begin + grain, count);
+            Submit([&body, begin, end]() { body(begin, end); }, &counter);
+        }
+        body(0u, grain);
+        Wait(counter);
+    }
+
+private:
+    struct Queue {
+        mutex      lock;
+        deque<Job> jobs;
+    };
+
+    vector<unique_ptr<Queue>> queues; // 0 is shared by the threads outside of the pool
+    vector<thread>            workers;
+    atomic<int>               queued{ 0 };
+    bool                      stop = false;
+    mutex                     sleepMutex;
+    condition_variable        wake;
+
+    static unsigned int& ThreadIndex()
+    {
+        static thread_local unsigned int index = 0;
+        return index;
+    }
+
+    // without workers a ready job runs right away
+    void Schedule(Job& job)
+    {
+        if (workers.empty())
+            Run(job);
+        else
+            Push(job);
+    }
+
+    void Push(const Job& job)
+    {
+        Queue& queue = *queues[ThreadIndex()];
+        {
+            lock_guard<mutex> lock(queue.lock);
+            queue.jobs.push_back(job);
+        }
+        queued++;
+        // taking the lock orders the push before a worker that is about to sleep checks for work
+        {
+            lock_guard<mutex> lock(sleepMutex);
+        }
+        wake.notify_one();
+    }
+
+    bool TryRun(unsigned int index)
+    {
+        Job job;
+        bool found = false;
+        {
+            Queue& own = *queues[index];
+            lock_guard<mutex> lock(own.lock);
+            if (!own.jobs.empty())
+            {
+                job = own.jobs.back();
+                own.jobs.pop_back();
+                found = true;
+            }
+        }
+        for (unsigned int i = 1; !found && i < queues.size(); i++)
+        {
+            Queue& victim = *queues[(index + i) % queues.size()];
+            lock_guard<mutex> lock(victim.lock);
+            if (!victim.jobs.empty())
+            {
+                job = victim.jobs.front();
+                victim.jobs.pop_front();
+                found = true;
+            }
+        }
+        if (!found) return false;
+
+        queued--;
+        Run(job);
+        return true;
+    }
+
+    void Run(Job& job)
+    {
+        job.task();
+        if (job.counter != nullptr)
+            Finish(*job.counter);
+    }
+
+    // releases the jobs that depended on the counter once its last job is done
+    void Finish(JobCounter& counter)
+    {
+        vector<Job> ready;
+        {
+            lock_guard<mutex> lock(counter.lock);
+            if (--counter.pending == 0)
+                ready.swap(counter.continuations);
+        }
+        for (Job& job : ready)
+            Schedule(job);
+    }
+
+    void WorkerLoop(unsigned int index)
+    {
+        ThreadIndex() = index;
+        while (true)
+        {
+            if (TryRun(index)) continue;
+            unique_lock<mutex> lock(sleepMutex);
+            wake.wait(lock, [this] { return stop || queued > 0; });
+            if (stop) break;
+        }
+    }
+};
+
+JobSystem jobSystem;
+#endif
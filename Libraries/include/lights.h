@@ -0,0 +1,97 @@
+#ifndef LIGHTS_H
+#define LIGHTS_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+using namespace std;
+
+// light contributions below this are treated as zero when bounding a light
+const float LIGHT_CUTOFF_BRIGHTNESS = 1.0f / 256.0f;
+const float LIGHT_MAX_RADIUS        = 100.0f;
+
+enum Light_Type {
+    LIGHT_POINT = 0,
+    LIGHT_SPOT  = 1
+};
+
+// One point or spot light, with the same terms as the LampLight and SpotlightLight shader structs.
+// Intensity scales diffuse and specular, like the lamp brightness level does.
+struct Light {
+    Light_Type type;
+
+    glm::vec3 position;
+    glm::vec3 direction;
+    float cutOff;
+    float outerCutOff;
+
+    glm::vec3 ambient;
+    glm::vec3 diffuse;
+    glm::vec3 specular;
+
+    float constant;
+    float linear;
+    float quadratic;
+
+    float intensity;
+
+    // distance at which the attenuated light drops below the cutoff brightness
+    float Radius() const
+    {
+        glm::vec3 peak = glm::max(ambient, intensity * glm::max(diffuse, specular));
+        float brightness = std::max(peak.r, std::max(peak.g, peak.b));
+        // solve brightness / (constant + linear * d + quadratic * d^2) = cutoff for d
+        float c = constant - brightness / LIGHT_CUTOFF_BRIGHTNESS;
+        if (c >= 0.0f) return 0.0f;
+        float d;
+        if (quadratic > 0.0f)
+            d = (-linear + std::sqrt(linear * linear - 4.0f * quadratic * c)) / (2.0f * quadratic);
+        else if (linear > 0.0f)
+            d = -c / linear;
+        else
+            d = LIGHT_MAX_RADIUS;
+        return std::min(d, LIGHT_MAX_RADIUS);
+    }
+};
+
+Light PointLight(glm::vec3 position, glm::vec3 color, float constant, float linear, float quadratic)
+{
+    Light light;
+    light.type = LIGHT_POINT;
+    light.position = position;
+    light.direction = glm::vec3(0, -1, 0);
+    light.cutOff = -1.0f;
+    light.outerCutOff = -1.0f;
+    light.ambient = color * 0.1f;
+    light.diffuse = color;
+    light.specular = glm::vec3(1.0f);
+    light.constant = constant;
+    light.linear = linear;
+    light.quadratic = quadratic;
+    light.intensity = 1.0f;
+    return light;
+}
+
+class LightList
+{
+public:
+    vector<Light> lights;
+
+    void Clear()
+    {
+        lights.clear();
+    }
+
+    void Add(const Light& light)
+    {
+        lights.push_back(light);
+    }
+
+    unsigned int Size() const
+    {
+        return (unsigned int)lights.size();
+    }
+};
+#endif
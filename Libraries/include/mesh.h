@@ -7,13 +7,21 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <shader.h>
+#include <glstate.h>
+#include <bounds.h>
 
+#include <cstdint>
 #include <string>
+#include <unordered_map>
 #include <vector>
 using namespace std;
 
 #define MAX_BONE_INFLUENCE 4
 
+const unsigned int MESH_LOD_COUNT = 3;
+// vertex clustering grid of every simplified level, in cells along the diagonal of the mesh bounds
+const float MESH_LOD_CELLS[MESH_LOD_COUNT - 1] = { 24.0f, 8.0f };
+
 struct Vertex {
     glm::vec3 Position;
     glm::vec3 Normal;
@@ -36,17 +44,48 @@ public:
     vector<unsigned int> indices;
     vector<Texture>      textures;
     unsigned int VAO;
+    // position-only stream sharing the index buffer, used by the depth pre-pass
+    unsigned int depthVAO;
+    // identifies the texture set, meshes with equal keys share their bindings
+    unsigned int materialKey;
+    // local space bounds, filled in on import
+    AABB           bounds;
+    BoundingSphere sphere;
+    // index ranges of the levels of detail, all stored in the one index buffer, level 0 is the
+    // mesh as imported
+    unsigned int lodFirst[MESH_LOD_COUNT];
+    unsigned int lodCount[MESH_LOD_COUNT];
 
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    // without upload the mesh can be built on any thread, Upload then has to run on the GL thread
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, bool upload = true)
     {
         this->vertices = vertices;
         this->indices = indices;
         this->textures = textures;
+        BuildLods();
+
+        if (upload)
+            Upload();
+    }
 
+    // creates the buffers, the texture ids have to be final by now
+    void Upload()
+    {
         SetupMesh();
+        SetupDepthStream();
+        SetupMaterialKey();
     }
 
     void Draw(Shader& shader)
+    {
+        BindTextures(shader);
+        glState.BindVertexArray(VAO);
+        DrawElements();
+    }
+
+    // binds every texture of the mesh to consecutive texture units
+    // ------------------------------------------------------------------------
+    void BindTextures(Shader& shader)
     {
         unsigned int diffuseNr = 1;
         unsigned int specularNr = 1;
@@ -54,7 +93,6 @@ public:
         unsigned int heightNr = 1;
         for (unsigned int i = 0; i < textures.size(); i++)
         {
-            glActiveTexture(GL_TEXTURE0 + i); 
             string number;
             string name = textures[i].type;
             if (name == "texture_diffuse")
@@ -67,18 +105,98 @@ public:
                 number = std::to_string(heightNr++);
 
             glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            glState.BindTexture(i, GL_TEXTURE_2D, textures[i].id);
         }
+    }
+
+    // issues the indexed draw, expects the VAO to be bound already
+    // ------------------------------------------------------------------------
+    void DrawElements(unsigned int lod = 0)
+    {
+        glDrawElements(GL_TRIANGLES, lodCount[lod], GL_UNSIGNED_INT, (void*)(lodFirst[lod] * sizeof(unsigned int)));
+    }
 
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
+    // the same draw repeated for every instance, expects the VAO to be bound already
+    // ------------------------------------------------------------------------
+    void DrawElementsInstanced(unsigned int lod, unsigned int instances)
+    {
+        glDrawElementsInstanced(GL_TRIANGLES, lodCount[lod], GL_UNSIGNED_INT, (void*)(lodFirst[lod] * sizeof(unsigned int)), instances);
+    }
 
-        glActiveTexture(GL_TEXTURE0);
+    // true if both meshes bind the same textures, the key only tells meshes apart quickly
+    bool SameMaterial(const Mesh& other) const
+    {
+        if (materialKey != other.materialKey || textures.size() != other.textures.size())
+            return false;
+        for (unsigned int i = 0; i < textures.size(); i++)
+            if (textures[i].id != other.textures[i].id || textures[i].type != other.textures[i].type)
+                return false;
+        return true;
     }
 
 private:
-    unsigned int VBO, EBO;
+    unsigned int VBO, EBO, positionVBO;
+
+    // appends every simplified level to the indices. Vertices are clustered on a grid, each cell
+    // is represented by the first vertex falling into it and triangles collapsing to a line or a
+    // point are dropped. The vertices are shared with level 0, only indices are added.
+    void BuildLods()
+    {
+        lodFirst[0] = 0;
+        lodCount[0] = (unsigned int)indices.size();
+        AABB box;
+        for (const Vertex& vertex : vertices)
+            box.Merge(vertex.Position);
+        float diagonal = box.IsEmpty() ? 0.0f : glm::length(box.max - box.min);
+
+        vector<unsigned int> representative(vertices.size());
+        unordered_map<uint64_t, unsigned int> cells;
+        for (unsigned int level = 1; level < MESH_LOD_COUNT; level++)
+        {
+            lodFirst[level] = (unsigned int)indices.size();
+            lodCount[level] = 0;
+            if (diagonal > 0.0f)
+            {
+                float cellSize = diagonal / MESH_LOD_CELLS[level - 1];
+                cells.clear();
+                for (unsigned int i = 0; i < vertices.size(); i++)
+                {
+                    glm::vec3 cell = glm::floor((vertices[i].Position - box.min) / cellSize);
+                    uint64_t key = ((uint64_t)cell.x << 42) | ((uint64_t)cell.y << 21) | (uint64_t)cell.z;
+                    representative[i] = cells.insert(std::make_pair(key, i)).first->second;
+                }
+                for (unsigned int i = 0; i + 2 < lodCount[0]; i += 3)
+                {
+                    unsigned int a = representative[indices[i]];
+                    unsigned int b = representative[indices[i + 1]];
+                    unsigned int c = representative[indices[i + 2]];
+                    if (a == b || b == c || a == c)
+                        continue;
+                    indices.push_back(a);
+                    indices.push_back(b);
+                    indices.push_back(c);
+                    lodCount[level] += 3;
+                }
+            }
+            // a mesh too small for the grid keeps the previous level
+            if (lodCount[level] == 0)
+            {
+                lodFirst[level] = lodFirst[level - 1];
+                lodCount[level] = lodCount[level - 1];
+            }
+        }
+    }
+
+    void SetupMaterialKey()
+    {
+        // FNV-1a over the texture ids
+        materialKey = 2166136261u;
+        for (unsigned int i = 0; i < textures.size(); i++)
+        {
+            materialKey ^= textures[i].id;
+            materialKey *= 16777619u;
+        }
+    }
 
     void SetupMesh()
     {
@@ -86,7 +204,7 @@ private:
         glGenBuffers(1, &VBO);
         glGenBuffers(1, &EBO);
 
-        glBindVertexArray(VAO);
+        glState.BindVertexArray(VAO);
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
         glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
 
@@ -114,7 +232,27 @@ private:
         
         glEnableVertexAttribArray(6);
         glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, m_Weights));
-        glBindVertexArray(0);
+        glState.BindVertexArray(0);
+    }
+
+    void SetupDepthStream()
+    {
+        // tightly packed positions, the depth pre-pass fetches 12 instead of 88 bytes per vertex
+        vector<glm::vec3> positions(vertices.size());
+        for (unsigned int i = 0; i < vertices.size(); i++)
+            positions[i] = vertices[i].Position;
+
+        glGenVertexArrays(1, &depthVAO);
+        glGenBuffers(1, &positionVBO);
+
+        glState.BindVertexArray(depthVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, positionVBO);
+        glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec3), &positions[0], GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+        glState.BindVertexArray(0);
     }
 };
 #endif
\ No newline at end of file
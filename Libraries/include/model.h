@@ -5,6 +5,8 @@
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
+#include <glm/gtc/quaternion.hpp>
 #include <stb/stb_image.h>
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
@@ -12,6 +14,11 @@
 
 #include <mesh.h>
 #include <shader.h>
+#include <renderqueue.h>
+#include <glstate.h>
+#include <bounds.h>
+#include <scenegraph.h>
+#include <jobs.h>
 
 #include <string>
 #include <fstream>
@@ -21,13 +28,33 @@
 #include <vector>
 using namespace std;
 
+// pixels decoded from an image file, not yet handed to GL
+struct TextureImage {
+    string path;
+    unsigned char* data;
+    int width, height, components;
+};
+
+// LOAD_LATER only imports the file and decodes the textures, safe on any thread,
+// Upload creates the GL objects later on the GL thread.
+enum Model_Load {
+    LOAD_NOW,
+    LOAD_LATER
+};
+
 unsigned int TextureFromFile(const char* path, const string& directory, bool gamma = false);
+TextureImage DecodeTexture(const char* path, const string& directory);
+unsigned int UploadTexture(TextureImage& image, bool gamma = false);
 
 class Model
 {
 public:
+    static const unsigned int MESH_MASK_BITS = 32;
+    static const unsigned int ALL_MESHES = 0xFFFFFFFF;
+
     vector<Texture> textures_loaded;	
     vector<Mesh>    meshes;
+    AABB            bounds; // local space bounds of all meshes
     glm::vec3       position;
     glm::vec3       scale;
     glm::vec3       rotation;
@@ -36,16 +63,117 @@ public:
 
     Model() {}
 
-    Model(string const& path, glm::vec3 position, float scale = 1.0f, glm::vec3 rotation = glm::vec3(0.0f), bool gamma = false)
+    Model(string const& path, glm::vec3 position, float scale = 1.0f, glm::vec3 rotation = glm::vec3(0.0f), bool gamma = false, Model_Load load = LOAD_NOW)
     {
         gammaCorrection = gamma;
         this->rotation = rotation;
         this->position = position;
         this->scale = glm::vec3(scale, scale, scale);
+        uploadLater = load == LOAD_LATER;
         LoadModel(path);
+        // every texture of the model is decoded in parallel
+        jobSystem.ParallelFor((unsigned int)pendingImages.size(), 1, [this](unsigned int begin, unsigned int end) {
+            for (unsigned int i = begin; i < end; i++)
+                pendingImages[i] = DecodeTexture(pendingImages[i].path.c_str(), directory);
+        });
+        if (!uploadLater)
+            Upload();
+    }
+
+    // creates the textures and buffers of a model loaded with LOAD_LATER, on the GL thread
+    void Upload()
+    {
+        for (unsigned int i = 0; i < pendingImages.size(); i++)
+            textures_loaded[i].id = UploadTexture(pendingImages[i], gammaCorrection);
+        pendingImages.clear();
+
+        for (Mesh& mesh : meshes)
+        {
+            for (Texture& texture : mesh.textures)
+                for (const Texture& loaded : textures_loaded)
+                    if (loaded.path == texture.path)
+                        texture.id = loaded.id;
+            mesh.Upload();
+        }
+        uploadLater = false;
+    }
+
+    // places one more copy of the model under the given scene node, the own position, rotation
+    // and scale of the model are relative to that parent
+    unsigned int AddNode(unsigned int parent) const
+    {
+        return sceneGraph.AddNode(parent, position, GetRotation(), scale, true);
+    }
+
+    // queues one draw packet per mesh instead of drawing immediately,
+    // with a frustum given meshes outside of it are skipped
+    void Submit(RenderQueue& queue, Render_Pass pass, Shader& shader, unsigned int node, const Frustum* frustum = nullptr, float brightness = 1.0f)
+    {
+        SubmitMeshes(queue, pass, shader, node, VisibleMeshes(node, frustum), brightness);
+    }
+
+    // one bit per mesh inside the frustum, read-only so jobs may call it,
+    // meshes past the width of the mask are always treated as visible
+    unsigned int VisibleMeshes(unsigned int node, const Frustum* frustum) const
+    {
+        if (frustum == nullptr || meshes.size() == 1)
+            return ALL_MESHES;
+        const glm::mat4& model = transformStore.Model(sceneGraph.Instance(node));
+        unsigned int mask = ALL_MESHES;
+        for (unsigned int i = 0; i < meshes.size() && i < MESH_MASK_BITS; i++)
+            if (!frustum->IntersectsSphere(meshes[i].sphere.Transform(model)))
+                mask &= ~(1u << i);
+        return mask;
+    }
+
+    // records into a render queue or a job's draw list
+    template<typename Target>
+    void SubmitMeshes(Target& queue, Render_Pass pass, Shader& shader, unsigned int node, unsigned int meshMask, float brightness = 1.0f)
+    {
+        unsigned int instance = sceneGraph.Instance(node);
+        const glm::mat4& model = transformStore.Model(instance);
+        const glm::mat3& normal = transformStore.Normal(instance);
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            if (i < MESH_MASK_BITS && !(meshMask & (1u << i)))
+                continue;
+            queue.Submit(pass, shader, meshes[i], model, normal, brightness);
+        }
+    }
+
+    // queues every mesh once for a batch of instance offsets in the stream buffer
+    void SubmitInstanced(RenderQueue& queue, Render_Pass pass, Shader& shader, unsigned int node,
+        unsigned int lod, unsigned int instanceOffset, unsigned int instanceCount)
+    {
+        unsigned int instance = sceneGraph.Instance(node);
+        const glm::mat4& model = transformStore.Model(instance);
+        const glm::mat3& normal = transformStore.Normal(instance);
+        for (Mesh& mesh : meshes)
+            queue.SubmitInstanced(pass, shader, mesh, model, normal, lod, instanceOffset, instanceCount);
+    }
+
+    AABB GetWorldBounds(unsigned int node) const
+    {
+        return bounds.Transform(transformStore.Model(sceneGraph.Instance(node)));
+    }
+
+    AABB GetWorldBounds(glm::vec3 offset = glm::vec3(0, 0, 0), glm::vec3 rotation = glm::vec3(0.0f)) const
+    {
+        return bounds.Transform(GetModelMatrix(offset, rotation));
+    }
+
+    // the own rotation of the model followed by the instance rotation, in the order of GetModelMatrix
+    glm::quat GetRotation(glm::vec3 rotation = glm::vec3(0.0f)) const
+    {
+        return glm::angleAxis(glm::radians(this->rotation.x), glm::vec3(1, 0, 0))
+            * glm::angleAxis(glm::radians(this->rotation.y), glm::vec3(0, 1, 0))
+            * glm::angleAxis(glm::radians(this->rotation.z), glm::vec3(0, 0, 1))
+            * glm::angleAxis(glm::radians(rotation.z), glm::vec3(0, 0, 1))
+            * glm::angleAxis(glm::radians(rotation.x), glm::vec3(1, 0, 0))
+            * glm::angleAxis(glm::radians(rotation.y), glm::vec3(0, 1, 0));
     }
 
-    void Draw(Shader& shader, glm::vec3 offset = glm::vec3(0, 0, 0), glm::vec3 rotation = glm::vec3(0.0f))
+    glm::mat4 GetModelMatrix(glm::vec3 offset = glm::vec3(0, 0, 0), glm::vec3 rotation = glm::vec3(0.0f)) const
     {
         glm::mat4 model = glm::mat4(1.0f);
         model = glm::translate(model, position + offset);
@@ -58,19 +186,19 @@ public:
         model = glm::rotate(model, glm::radians(rotation.x), glm::vec3(1, 0, 0));
         model = glm::rotate(model, glm::radians(rotation.y), glm::vec3(0, 1, 0));
 
-
-
         model = glm::scale(model, scale);
-        shader.SetMat4("model", model);
-        for (unsigned int i = 0; i < meshes.size(); i++)
-            meshes[i].Draw(shader);
+        return model;
     }
 
 private:
+    bool uploadLater = false;
+    // decoded in the constructor, in the order of textures_loaded
+    vector<TextureImage> pendingImages;
+
     void LoadModel(string const& path)
     {
         Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace | aiProcess_GenBoundingBoxes);
         if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
             cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
@@ -87,6 +215,7 @@ private:
         {
             aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
             meshes.push_back(ProcessMesh(mesh, scene));
+            bounds.Merge(meshes.back().bounds);
         }
         for (unsigned int i = 0; i < node->mNumChildren; i++)
         {
@@ -165,8 +294,17 @@ private:
         std::vector<Texture> heightMaps = LoadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
         textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
 
-        
-        return Mesh(vertices, indices, textures);
+
+        // buffers are created with the textures in Upload
+        Mesh result(vertices, indices, textures, false);
+        result.bounds = AABB(glm::vec3(mesh->mAABB.mMin.x, mesh->mAABB.mMin.y, mesh->mAABB.mMin.z),
+                             glm::vec3(mesh->mAABB.mMax.x, mesh->mAABB.mMax.y, mesh->mAABB.mMax.z));
+        float radius = 0.0f;
+        for (unsigned int i = 0; i < vertices.size(); i++)
+            radius = std::max(radius, glm::length(vertices[i].Position - result.bounds.Center()));
+        result.sphere = BoundingSphere(result.bounds.Center(), radius);
+
+        return result;
     }
 
     
@@ -191,11 +329,14 @@ private:
             if (!skip)
             {   
                 Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
+                texture.id = 0;
                 texture.type = typeName;
                 texture.path = str.C_Str();
                 textures.push_back(texture);
                 textures_loaded.push_back(texture);  
+                TextureImage image = TextureImage();
+                image.path = texture.path;
+                pendingImages.push_back(image);
             }
         }
         return textures;
@@ -205,26 +346,39 @@ private:
 
 unsigned int TextureFromFile(const char* path, const string& directory, bool gamma)
 {
-    string filename = string(path);
-    filename = directory + '/' + filename;
+    TextureImage image = DecodeTexture(path, directory);
+    return UploadTexture(image, gamma);
+}
+
+// reads and decodes the file without touching GL, safe to call from jobs
+TextureImage DecodeTexture(const char* path, const string& directory)
+{
+    TextureImage image = TextureImage();
+    image.path = path;
+    string filename = directory + '/' + string(path);
+    image.data = stbi_load(filename.c_str(), &image.width, &image.height, &image.components, 0);
+    return image;
+}
 
+// creates the texture and frees the decoded pixels
+unsigned int UploadTexture(TextureImage& image, bool gamma)
+{
     unsigned int textureID;
     glGenTextures(1, &textureID);
 
-    int width, height, nrComponents;
-    unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
+    unsigned char* data = image.data;
     if (data)
     {
         GLenum format;
-        if (nrComponents == 1)
+        if (image.components == 1)
             format = GL_RED;
-        else if (nrComponents == 3)
+        else if (image.components == 3)
             format = GL_RGB;
-        else if (nrComponents == 4)
+        else if (image.components == 4)
             format = GL_RGBA;
 
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+        glState.BindTexture(GL_TEXTURE_2D, textureID);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, data);
         glGenerateMipmap(GL_TEXTURE_2D);
 
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -236,9 +390,10 @@ unsigned int TextureFromFile(const char* path, const string& directory, bool gam
     }
     else
     {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
+        std::cout << "Texture failed to load at path: " << image.path << std::endl;
         stbi_image_free(data);
     }
+    image.data = nullptr;
 
     return textureID;
 }
@@ -0,0 +1,158 @@
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <shader.h>
+#include <glstate.h>
+#include <bounds.h>
+#include <bvh.h>
+
+#include <vector>
+using namespace std;
+
+// boxes are grown a little, so a query never loses against the depth of the object it encloses
+const float OCCLUSION_BOX_MARGIN = 0.01f;
+
+// Hardware occlusion queries on the bounding boxes of occludees.
+// Queries are issued after the opaque pass and their results are only read back in a later frame,
+// so the CPU never waits for the GPU. An occluded object stays hidden until its box becomes visible
+// again, objects leaving the frustum or containing the camera are always treated as visible.
+class OcclusionCuller
+{
+public:
+    bool Enabled = true;
+
+    OcclusionCuller(const char* vertexPath, const char* fragmentPath) : boundsShader(vertexPath, fragmentPath)
+    {
+        SetupBox();
+    }
+
+    void AddOccludee(unsigned int objectId)
+    {
+        Occludee occludee;
+        occludee.objectId = objectId;
+        glGenQueries(1, &occludee.query);
+        occludee.pending = false;
+        occludee.occluded = false;
+        occludees.push_back(occludee);
+    }
+
+    // hides the occludees that were occluded when last queried
+    void Apply(SceneBVH& bvh, glm::vec3 viewPos)
+    {
+        for (unsigned int i = 0; i < occludees.size(); i++)
+        {
+            Occludee& occludee = occludees[i];
+            if (!Enabled || !bvh.IsVisible(occludee.objectId) || ContainsViewer(bvh, occludee.objectId, viewPos))
+            {
+                occludee.occluded = false;
+                continue;
+            }
+            if (occludee.occluded)
+                bvh.Hide(occludee.objectId);
+        }
+    }
+
+    // collects finished results and tests the boxes of in-frustum occludees against the current depth buffer
+    void IssueQueries(const SceneBVH& bvh, const glm::mat4& projection, const glm::mat4& view)
+    {
+        if (!Enabled) return;
+
+        glState.ColorMask(false);
+        glState.DepthMask(false);
+        boundsShader.Use();
+        boundsShader.SetMat4("projection", projection);
+        boundsShader.SetMat4("view", view);
+        glState.BindVertexArray(boxVAO);
+
+        for (unsigned int i = 0; i < occludees.size(); i++)
+        {
+            Occludee& occludee = occludees[i];
+            if (occludee.pending)
+            {
+                GLuint available = 0;
+                glGetQueryObjectuiv(occludee.query, GL_QUERY_RESULT_AVAILABLE, &available);
+                if (!available)
+                    continue;
+                GLuint anySamplesPassed = 0;
+                glGetQueryObjectuiv(occludee.query, GL_QUERY_RESULT, &anySamplesPassed);
+                occludee.occluded = anySamplesPassed == 0;
+                occludee.pending = false;
+            }
+
+            // hidden occludees are frustum-visible too, Apply only hid them after the frustum test
+            const AABB& bounds = bvh.GetBounds(occludee.objectId);
+            if (!occludee.occluded && !bvh.IsVisible(occludee.objectId))
+                continue;
+
+            glm::vec3 size = bounds.max - bounds.min + glm::vec3(2 * OCCLUSION_BOX_MARGIN);
+            glm::mat4 model = glm::translate(glm::mat4(1.0f), bounds.min - glm::vec3(OCCLUSION_BOX_MARGIN));
+            model = glm::scale(model, size);
+            boundsShader.SetMat4("model", model);
+
+            glBeginQuery(GL_ANY_SAMPLES_PASSED, occludee.query);
+            glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+            glEndQuery(GL_ANY_SAMPLES_PASSED);
+            occludee.pending = true;
+        }
+
+        glState.ColorMask(true);
+        glState.DepthMask(true);
+    }
+
+private:
+    struct Occludee {
+        unsigned int objectId;
+        unsigned int query;
+        bool pending;
+        bool occluded;
+    };
+
+    Shader boundsShader;
+    vector<Occludee> occludees;
+    unsigned int boxVAO, boxVBO, boxEBO;
+
+    bool ContainsViewer(const SceneBVH& bvh, unsigned int objectId, glm::vec3 viewPos) const
+    {
+        // the near plane would clip the box faces around the camera, so never trust such a query
+        AABB bounds = bvh.GetBounds(objectId);
+        bounds.min -= glm::vec3(0.2f);
+        bounds.max += glm::vec3(0.2f);
+        return bounds.Contains(viewPos);
+    }
+
+    void SetupBox()
+    {
+        float vertices[] = {
+            0, 0, 0,  1, 0, 0,  1, 1, 0,  0, 1, 0,
+            0, 0, 1,  1, 0, 1,  1, 1, 1,  0, 1, 1
+        };
+        unsigned int indices[] = {
+            0, 2, 1,  0, 3, 2,
+            4, 5, 6,  4, 6, 7,
+            0, 1, 5,  0, 5, 4,
+            3, 6, 2,  3, 7, 6,
+            0, 4, 7,  0, 7, 3,
+            1, 2, 6,  1, 6, 5
+        };
+
+        glGenVertexArrays(1, &boxVAO);
+        glGenBuffers(1, &boxVBO);
+        glGenBuffers(1, &boxEBO);
+
+        glState.BindVertexArray(boxVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, boxVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, boxEBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+        glState.BindVertexArray(0);
+    }
+};
+#endif
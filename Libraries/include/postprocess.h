@@ -0,0 +1,187 @@
+#ifndef POSTPROCESS_H
+#define POSTPROCESS_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <shader.h>
+#include <glstate.h>
+#include <gputimer.h>
+
+#include <iostream>
+#include <string>
+using namespace std;
+
+// Post-processing of the finished scene. While it is used the scene is drawn into an offscreen
+// target instead of the window. The passes run at the scene resolution, each one reading the
+// image of the previous one, and the last pass writes the window, upscaling and sharpening the
+// image when the scene was drawn smaller. The targets have the window size, a smaller scene only
+// uses their lower left part, so a new scale never reallocates them.
+//
+// Passes, in order: fog, FXAA, upscale into the window.
+//
+// Targets:
+//   0: RGBA8 scene color, DEPTH24_STENCIL8 scene depth (the format of the G-buffer depth)
+//   1: RGBA8 color, the other side of the ping-pong between passes
+class PostProcess
+{
+public:
+    // FXAA over the scene, its cost depends on the pixel count only
+    bool Antialiasing = false;
+    // distance fog levels 1 - 3 applied once per pixel from the scene depth, 0 is off
+    int FogLevel = 0;
+
+    PostProcess(const char* shaderDirectory)
+        : fogShader((string(shaderDirectory) + "fullscreen_shader.vert").c_str(), (string(shaderDirectory) + "fog_shader.frag").c_str()),
+          fxaaShader((string(shaderDirectory) + "fullscreen_shader.vert").c_str(), (string(shaderDirectory) + "fxaa_shader.frag").c_str()),
+          presentShader((string(shaderDirectory) + "fullscreen_shader.vert").c_str(), (string(shaderDirectory) + "upscale_shader.frag").c_str())
+    {
+        glGenVertexArrays(1, &emptyVAO);
+    }
+
+    // binds the scene target with a viewport of the scene size
+    void Begin(int windowWidth, int windowHeight, int sceneWidth, int sceneHeight)
+    {
+        Resize(windowWidth, windowHeight);
+        width = sceneWidth;
+        height = sceneHeight;
+
+        glState.SceneFramebuffer = framebuffers[0];
+        glState.BindFramebuffer(GL_FRAMEBUFFER, framebuffers[0]);
+        glViewport(0, 0, width, height);
+    }
+
+    // camera of the frame, the fog pass reconstructs distances from the depth with it
+    void SetCamera(const glm::mat4& projection, const glm::mat4& view, glm::vec3 viewPos)
+    {
+        inverseViewProjection = glm::inverse(projection * view);
+        this->viewPos = viewPos;
+    }
+
+    // runs the enabled passes and writes the result into the window
+    void End(float sharpness)
+    {
+        int source = 0;
+        glState.Disable(GL_DEPTH_TEST);
+        glState.BindVertexArray(emptyVAO);
+
+        if (FogLevel > 0)
+        {
+            fogTimer.Begin();
+            glState.BindFramebuffer(GL_FRAMEBUFFER, framebuffers[1 - source]);
+            fogShader.Use();
+            fogShader.SetInt("depthTexture", 1);
+            fogShader.SetMat4("inverseViewProjection", inverseViewProjection);
+            fogShader.SetVec3("viewPos", viewPos);
+            fogShader.SetFloat("fogLevel", (float)FogLevel);
+            glState.BindTexture(1, GL_TEXTURE_2D, depthTexture);
+            RunPass(fogShader, colorTextures[source]);
+            fogTimer.End();
+            source = 1 - source;
+        }
+
+        if (Antialiasing)
+        {
+            antialiasingTimer.Begin();
+            glState.BindFramebuffer(GL_FRAMEBUFFER, framebuffers[1 - source]);
+            RunPass(fxaaShader, colorTextures[source]);
+            antialiasingTimer.End();
+            source = 1 - source;
+        }
+
+        glState.SceneFramebuffer = 0;
+        glState.BindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, targetWidth, targetHeight);
+        presentShader.Use();
+        presentShader.SetFloat("sharpness", sharpness);
+        RunPass(presentShader, colorTextures[source]);
+
+        glState.Enable(GL_DEPTH_TEST);
+    }
+
+    float AntialiasingMs() const
+    {
+        return antialiasingTimer.LastMs();
+    }
+
+    float FogMs() const
+    {
+        return fogTimer.LastMs();
+    }
+
+private:
+    Shader fogShader;
+    Shader fxaaShader;
+    Shader presentShader;
+    unsigned int emptyVAO;
+    unsigned int framebuffers[2] = { 0, 0 };
+    unsigned int colorTextures[2] = { 0, 0 };
+    unsigned int depthTexture = 0;
+    int targetWidth = 0, targetHeight = 0;
+    int width = 0, height = 0;
+    GpuTimer fogTimer;
+    GpuTimer antialiasingTimer;
+    glm::mat4 inverseViewProjection = glm::mat4(1.0f);
+    glm::vec3 viewPos = glm::vec3(0.0f);
+
+    // draws the full-screen triangle reading the scene image from the given texture
+    void RunPass(Shader& shader, unsigned int texture)
+    {
+        shader.Use();
+        shader.SetInt("sceneTexture", 0);
+        shader.SetVec2("sourceSize", glm::vec2((float)width, (float)height));
+        shader.SetVec2("textureSize", glm::vec2((float)targetWidth, (float)targetHeight));
+        glState.BindTexture(0, GL_TEXTURE_2D, texture);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+
+    // recreates the targets when the window size changed
+    void Resize(int windowWidth, int windowHeight)
+    {
+        if (windowWidth == targetWidth && windowHeight == targetHeight) return;
+        if (windowWidth <= 0 || windowHeight <= 0) return;
+        targetWidth = windowWidth;
+        targetHeight = windowHeight;
+
+        if (framebuffers[0] != 0)
+        {
+            glDeleteFramebuffers(2, framebuffers);
+            glDeleteTextures(2, colorTextures);
+            glDeleteTextures(1, &depthTexture);
+            glState.Invalidate();
+        }
+
+        glGenFramebuffers(2, framebuffers);
+        for (int i = 0; i < 2; i++)
+        {
+            glState.BindFramebuffer(GL_FRAMEBUFFER, framebuffers[i]);
+            // linear filtering serves the fractional taps of FXAA and the bilinear upscale
+            colorTextures[i] = CreateTexture(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, GL_LINEAR);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTextures[i], 0);
+            if (i == 0)
+            {
+                // same format as the G-buffer depth, so the deferred path can blit it in
+                depthTexture = CreateTexture(GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, GL_NEAREST);
+                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+            }
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+                std::cout << "ERROR::POSTPROCESS::TARGET_INCOMPLETE" << std::endl;
+        }
+        glState.BindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    unsigned int CreateTexture(GLint internalFormat, GLenum format, GLenum type, GLint filter)
+    {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        glState.BindTexture(0, GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, targetWidth, targetHeight, 0, format, type, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        return texture;
+    }
+};
+#endif
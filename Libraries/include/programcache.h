@@ -0,0 +1,205 @@
+#ifndef PROGRAMCACHE_H
+#define PROGRAMCACHE_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+// GL_ARB_get_program_binary, core since OpenGL 4.1, so glad for 3.3 does not load it
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH           0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS      0x87FE
+typedef void (APIENTRYP PFNGLGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP PFNGLPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (APIENTRYP PFNGLPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+
+const uint32_t PROGRAM_CACHE_MAGIC   = 0x42443343; // "C3DB"
+const uint32_t PROGRAM_CACHE_VERSION = 1;
+
+struct ProgramCacheStats {
+    unsigned int hits;
+    unsigned int misses;
+    unsigned int rejected; // binaries the driver refused, they were compiled again
+};
+
+// On-disk cache of linked program binaries. A program is stored under a hash of its preprocessed
+// sources, its defines and the driver vendor, renderer and version strings, so any change to one
+// of them misses. Files keep the full driver string and are verified before use, a binary the
+// driver rejects is simply compiled from text again and overwritten.
+class ProgramBinaryCache
+{
+public:
+    bool Enabled = true;
+    ProgramCacheStats stats = ProgramCacheStats();
+
+    // loads the entry points, without them every program is compiled from text
+    void Init(GLADloadproc loader, const std::string& directory)
+    {
+        this->directory = directory;
+        getProgramBinary = (PFNGLGETPROGRAMBINARYPROC)loader("glGetProgramBinary");
+        programBinary = (PFNGLPROGRAMBINARYPROC)loader("glProgramBinary");
+        programParameteri = (PFNGLPROGRAMPARAMETERIPROC)loader("glProgramParameteri");
+
+        GLint formats = 0;
+        if (getProgramBinary != nullptr && programBinary != nullptr && programParameteri != nullptr)
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        supported = formats > 0;
+
+        driver = string((const char*)glGetString(GL_VENDOR)) + "|" + (const char*)glGetString(GL_RENDERER) + "|" + (const char*)glGetString(GL_VERSION);
+        if (supported)
+            MakeDirectory(directory);
+    }
+
+    bool Available() const
+    {
+        return Enabled && supported;
+    }
+
+    uint64_t MakeKey(const vector<string>& sources, const vector<string>& defines) const
+    {
+        uint64_t hash = 14695981039346656037ull;
+        hash = Hash(hash, driver);
+        for (const string& source : sources)
+            hash = Hash(hash, source);
+        for (const string& define : defines)
+            hash = Hash(hash, define);
+        return hash;
+    }
+
+    // has to be called before linking, otherwise the driver may not keep a retrievable binary
+    void PrepareForStore(GLuint program)
+    {
+        if (Available())
+            programParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    // links the program from a cached binary, returns false if there is none or it was rejected
+    bool Load(GLuint program, uint64_t key)
+    {
+        if (!Available()) return false;
+
+        FILE* file = std::fopen(FilePath(key).c_str(), "rb");
+        if (file == nullptr)
+        {
+            stats.misses++;
+            return false;
+        }
+
+        uint32_t header[2] = { 0, 0 };
+        uint32_t driverLength = 0;
+        GLenum format = 0;
+        uint32_t length = 0;
+        string storedDriver;
+        vector<char> binary;
+        bool valid = std::fread(header, sizeof(header), 1, file) == 1
+            && header[0] == PROGRAM_CACHE_MAGIC && header[1] == PROGRAM_CACHE_VERSION
+            && std::fread(&driverLength, sizeof(driverLength), 1, file) == 1 && driverLength < 4096;
+        if (valid)
+        {
+            storedDriver.resize(driverLength);
+            valid = (driverLength == 0 || std::fread(&storedDriver[0], driverLength, 1, file) == 1)
+                && storedDriver == driver
+                && std::fread(&format, sizeof(format), 1, file) == 1
+                && std::fread(&length, sizeof(length), 1, file) == 1 && length > 0;
+        }
+        if (valid)
+        {
+            binary.resize(length);
+            valid = std::fread(&binary[0], length, 1, file) == 1;
+        }
+        std::fclose(file);
+
+        if (valid)
+        {
+            programBinary(program, format, &binary[0], (GLsizei)length);
+            GLint success = 0;
+            glGetProgramiv(program, GL_LINK_STATUS, &success);
+            valid = success != 0;
+        }
+        if (valid) stats.hits++;
+        else stats.rejected++;
+        return valid;
+    }
+
+    void Store(GLuint program, uint64_t key)
+    {
+        if (!Available()) return;
+
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0) return;
+
+        vector<char> binary(length);
+        GLenum format = 0;
+        GLsizei written = 0;
+        getProgramBinary(program, length, &written, &format, &binary[0]);
+        if (written <= 0) return;
+
+        FILE* file = std::fopen(FilePath(key).c_str(), "wb");
+        if (file == nullptr)
+        {
+            std::cout << "ERROR::PROGRAM_CACHE::FILE_NOT_WRITABLE: " << FilePath(key) << std::endl;
+            return;
+        }
+        uint32_t header[2] = { PROGRAM_CACHE_MAGIC, PROGRAM_CACHE_VERSION };
+        uint32_t driverLength = (uint32_t)driver.size();
+        uint32_t binaryLength = (uint32_t)written;
+        std::fwrite(header, sizeof(header), 1, file);
+        std::fwrite(&driverLength, sizeof(driverLength), 1, file);
+        std::fwrite(driver.data(), driverLength, 1, file);
+        std::fwrite(&format, sizeof(format), 1, file);
+        std::fwrite(&binaryLength, sizeof(binaryLength), 1, file);
+        std::fwrite(&binary[0], binaryLength, 1, file);
+        std::fclose(file);
+    }
+
+private:
+    PFNGLGETPROGRAMBINARYPROC getProgramBinary = nullptr;
+    PFNGLPROGRAMBINARYPROC programBinary = nullptr;
+    PFNGLPROGRAMPARAMETERIPROC programParameteri = nullptr;
+    bool supported = false;
+    string directory;
+    string driver;
+
+    // FNV-1a, the length is mixed in so the concatenation of fields stays unambiguous
+    static uint64_t Hash(uint64_t hash, const string& text)
+    {
+        for (unsigned char c : text)
+            hash = (hash ^ c) * 1099511628211ull;
+        uint64_t length = text.size();
+        for (int i = 0; i < 8; i++)
+            hash = (hash ^ ((length >> (i * 8)) & 0xff)) * 1099511628211ull;
+        return hash;
+    }
+
+    string FilePath(uint64_t key) const
+    {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+        return directory + name;
+    }
+
+    static void MakeDirectory(const string& path)
+    {
+#ifdef _WIN32
+        _mkdir(path.c_str());
+#else
+        mkdir(path.c_str(), 0755);
+#endif
+    }
+};
+
+ProgramBinaryCache programBinaryCache;
+#endif
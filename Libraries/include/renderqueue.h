@@ -0,0 +1,385 @@
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <mesh.h>
+#include <shader.h>
+#include <glstate.h>
+#include <streambuffer.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+using namespace std;
+
+// Passes are executed in ascending order, so the pass occupies the top bits of the key.
+enum Render_Pass {
+    PASS_OPAQUE   = 0,
+    PASS_EMISSIVE = 1
+};
+
+// Sort key layout (most significant first):
+//   63..60 pass | 59..52 program | 51..36 material | 35..20 VAO | 19..0 depth
+// Program, material and VAO are only hashed into the key to group equal state together,
+// the executor compares the programs, texture ids and VAOs themselves, so a collision costs a
+// bind, not a wrong draw.
+const int KEY_PASS_SHIFT     = 60;
+const int KEY_PROGRAM_SHIFT  = 52;
+const int KEY_MATERIAL_SHIFT = 36;
+const int KEY_VAO_SHIFT      = 20;
+const uint64_t KEY_DEPTH_MAX = (1u << 20) - 1;
+
+const float RENDER_QUEUE_FAR_PLANE      = 100.0f;
+const unsigned int RENDER_QUEUE_CAPACITY = 1024;
+const unsigned int DRAW_LIST_CAPACITY    = 256;
+// instances per instanced packet, the size of the InstanceData block in Shaders/draw_data.glsl
+const unsigned int INSTANCE_BATCH        = 1024;
+
+// std140 layout of the DrawData block in Shaders/draw_data.glsl
+struct DrawData {
+    glm::mat4 model;
+    glm::vec4 normal[3];  // std140 pads every mat3 column to a vec4
+    float     brightness;
+    float     padding[3];
+};
+
+struct DrawPacket {
+    uint64_t  key;
+    Shader*   shader;
+    Mesh*     mesh;
+    glm::mat4 model;
+    glm::mat3 normal;     // inverse transpose of the model rotation and scale
+    float     brightness; // set as brightnessLevel for emissive packets, they share one program
+    unsigned int lod;     // level of detail of the mesh
+    // instanced packets draw the mesh once per offset in the stream buffer, 0 instances is a plain draw
+    unsigned int instanceBuffer;
+    unsigned int instanceOffset;
+    unsigned int instanceCount;
+};
+
+uint64_t MakeSortKey(Render_Pass pass, unsigned int program, unsigned int material, unsigned int vao, glm::vec3 position, glm::vec3 viewPos)
+{
+    // opaque draws go front-to-back, so nearer objects fill the depth buffer first
+    float distance = glm::length(position - viewPos) / RENDER_QUEUE_FAR_PLANE;
+    uint64_t depth = (uint64_t)(glm::clamp(distance, 0.0f, 1.0f) * KEY_DEPTH_MAX);
+
+    return ((uint64_t)(pass & 0xF) << KEY_PASS_SHIFT)
+        | ((uint64_t)(program & 0xFF) << KEY_PROGRAM_SHIFT)
+        | ((uint64_t)((material ^ (material >> 16)) & 0xFFFF) << KEY_MATERIAL_SHIFT)
+        | ((uint64_t)(vao & 0xFFFF) << KEY_VAO_SHIFT)
+        | depth;
+}
+
+DrawPacket MakeDrawPacket(Render_Pass pass, Shader& shader, Mesh& mesh, const glm::mat4& model, const glm::mat3& normal, float brightness, glm::vec3 viewPos)
+{
+    DrawPacket packet;
+    packet.shader = &shader;
+    packet.mesh = &mesh;
+    packet.model = model;
+    packet.normal = normal;
+    packet.brightness = brightness;
+    packet.lod = 0;
+    packet.instanceBuffer = 0;
+    packet.instanceOffset = 0;
+    packet.instanceCount = 0;
+    packet.key = MakeSortKey(pass, shader.ID, mesh.materialKey, mesh.VAO, glm::vec3(model[3]), viewPos);
+    return packet;
+}
+
+// Packets recorded by one job for its slice of the scene, appended to the render queue on the GL
+// thread afterwards. Recording touches no GL state and, once the list has grown to the size of
+// its slice, allocates nothing.
+class DrawList
+{
+public:
+    DrawList()
+    {
+        packets.reserve(DRAW_LIST_CAPACITY);
+    }
+
+    void Begin(glm::vec3 viewPos)
+    {
+        this->viewPos = viewPos;
+        packets.clear();
+    }
+
+    void Submit(Render_Pass pass, Shader& shader, Mesh& mesh, const glm::mat4& model, const glm::mat3& normal, float brightness = 1.0f)
+    {
+        packets.push_back(MakeDrawPacket(pass, shader, mesh, model, normal, brightness, viewPos));
+    }
+
+    const DrawPacket& operator[](unsigned int index) const
+    {
+        return packets[index];
+    }
+
+    unsigned int Size() const
+    {
+        return (unsigned int)packets.size();
+    }
+
+private:
+    vector<DrawPacket> packets;
+    glm::vec3          viewPos;
+};
+
+struct RenderQueueStats {
+    unsigned int drawCalls;
+    unsigned int triangles;
+    unsigned int stateChangesSubmitted; // state changes the submission order would have caused
+    unsigned int stateChangesExecuted;  // state changes after sorting
+};
+
+class RenderQueue
+{
+public:
+    RenderQueueStats stats;
+
+    RenderQueue(unsigned int capacity = RENDER_QUEUE_CAPACITY)
+    {
+        // storage is reserved once, clearing keeps the capacity so frames do not allocate
+        packets.reserve(capacity);
+        order.reserve(capacity);
+        stats = RenderQueueStats();
+    }
+
+    void Begin(glm::vec3 viewPos)
+    {
+        this->viewPos = viewPos;
+        packets.clear();
+        order.clear();
+        drawDataWritten = false;
+        stats = RenderQueueStats();
+    }
+
+    void Submit(Render_Pass pass, Shader& shader, Mesh& mesh, const glm::mat4& model, const glm::mat3& normal, float brightness = 1.0f)
+    {
+        Add(MakeDrawPacket(pass, shader, mesh, model, normal, brightness, viewPos));
+    }
+
+    // one draw of the mesh per vec4 offset at instanceOffset in the stream buffer, at most
+    // INSTANCE_BATCH of them, the shader has to be an instanced variant
+    void SubmitInstanced(Render_Pass pass, Shader& shader, Mesh& mesh, const glm::mat4& model, const glm::mat3& normal,
+        unsigned int lod, unsigned int instanceOffset, unsigned int instanceCount)
+    {
+        DrawPacket packet = MakeDrawPacket(pass, shader, mesh, model, normal, 1.0f, viewPos);
+        packet.lod = lod;
+        packet.instanceBuffer = streamBuffer.Buffer();
+        packet.instanceOffset = instanceOffset;
+        packet.instanceCount = instanceCount;
+        Add(packet);
+    }
+
+    // merges a list recorded by a job, lists appended in a fixed order give the same frame every time
+    void Append(const DrawList& list)
+    {
+        for (unsigned int i = 0; i < list.Size(); i++)
+            Add(list[i]);
+    }
+
+    glm::vec3 ViewPosition() const
+    {
+        return viewPos;
+    }
+
+    void Sort()
+    {
+        std::sort(order.begin(), order.end(), [](const SortItem& a, const SortItem& b) {
+            return a.key < b.key;
+        });
+    }
+
+    // executes the sorted packets of the passes in [firstPass, lastPass]
+    void Execute(Render_Pass firstPass = PASS_OPAQUE, Render_Pass lastPass = PASS_EMISSIVE)
+    {
+        WriteDrawData();
+        CountStateChanges(firstPass, lastPass, false);
+        Shader* currentShader = nullptr;
+        const Mesh* currentMaterial = nullptr;
+        unsigned int currentVAO = 0;
+
+        for (unsigned int i = 0; i < order.size(); i++)
+        {
+            uint64_t pass = order[i].key >> KEY_PASS_SHIFT;
+            if (pass < (uint64_t)firstPass || pass > (uint64_t)lastPass)
+                continue;
+
+            DrawPacket& packet = packets[order[i].index];
+            if (packet.shader != currentShader)
+            {
+                packet.shader->Use();
+                currentShader = packet.shader;
+                // sampler uniforms belong to the program, so the material has to be rebound
+                currentMaterial = nullptr;
+            }
+            if (currentMaterial == nullptr || !packet.mesh->SameMaterial(*currentMaterial))
+            {
+                packet.mesh->BindTextures(*packet.shader);
+                currentMaterial = packet.mesh;
+            }
+            if (packet.mesh->VAO != currentVAO)
+            {
+                glState.BindVertexArray(packet.mesh->VAO);
+                currentVAO = packet.mesh->VAO;
+            }
+            BindDrawData(order[i].index);
+            Draw(packet);
+        }
+    }
+
+    // draws the packets of one pass with the position-only streams and a single program,
+    // instanced packets with the instanced variant of it or not at all without one,
+    // the caller sets up depth-only output
+    void ExecuteDepthOnly(Shader& depthShader, Render_Pass pass = PASS_OPAQUE, Shader* instancedShader = nullptr)
+    {
+        WriteDrawData();
+        CountStateChanges(pass, pass, true);
+        Shader* currentShader = nullptr;
+        for (unsigned int i = 0; i < order.size(); i++)
+        {
+            if ((order[i].key >> KEY_PASS_SHIFT) != (uint64_t)pass)
+                continue;
+
+            DrawPacket& packet = packets[order[i].index];
+            Shader* shader = packet.instanceCount > 0 ? instancedShader : &depthShader;
+            if (shader == nullptr)
+                continue;
+            if (shader != currentShader)
+            {
+                shader->Use();
+                currentShader = shader;
+            }
+            glState.BindVertexArray(packet.mesh->depthVAO);
+            BindDrawData(order[i].index);
+            Draw(packet);
+        }
+    }
+
+    unsigned int Size() const
+    {
+        return (unsigned int)packets.size();
+    }
+
+private:
+    struct SortItem {
+        uint64_t key;
+        unsigned int index;
+    };
+
+    vector<DrawPacket> packets;
+    vector<SortItem>   order;
+    glm::vec3          viewPos;
+    // where the draw data of the packets was written to, valid in the stream buffer frame it was
+    // written in. The buffer is kept, a later grow replaces the stream buffer but not this data.
+    unsigned int       drawDataBuffer = 0;
+    unsigned int       drawDataOffset = 0;
+    unsigned int       drawDataStride = 0;
+    unsigned int       drawDataFrame = 0;
+    bool               drawDataWritten = false;
+
+    // writes the draw data of every packet into the stream buffer once per frame, in packet order,
+    // so queues executed several times (shadow cube faces) share it
+    void WriteDrawData()
+    {
+        if (packets.empty() || (drawDataWritten && drawDataFrame == streamBuffer.Frame()))
+            return;
+        drawDataStride = streamBuffer.UniformStride(sizeof(DrawData));
+        unsigned char* data = (unsigned char*)streamBuffer.Allocate((unsigned int)packets.size() * drawDataStride, drawDataOffset);
+        for (unsigned int i = 0; i < packets.size(); i++)
+        {
+            // built on the stack and copied, mapped memory may be write combined and is never read
+            DrawData block;
+            block.model = packets[i].model;
+            for (int column = 0; column < 3; column++)
+                block.normal[column] = glm::vec4(packets[i].normal[column], 0.0f);
+            block.brightness = packets[i].brightness;
+            block.padding[0] = block.padding[1] = block.padding[2] = 0.0f;
+            std::memcpy(data + i * drawDataStride, &block, sizeof(DrawData));
+        }
+        streamBuffer.Flush();
+        drawDataBuffer = streamBuffer.Buffer();
+        drawDataFrame = streamBuffer.Frame();
+        drawDataWritten = true;
+    }
+
+    void BindDrawData(unsigned int packet)
+    {
+        glState.BindUniformRange(DRAW_DATA_BINDING, drawDataBuffer, drawDataOffset + packet * drawDataStride, sizeof(DrawData));
+    }
+
+    void Draw(const DrawPacket& packet)
+    {
+        unsigned int triangles = packet.mesh->lodCount[packet.lod] / 3;
+        if (packet.instanceCount > 0)
+        {
+            glState.BindUniformRange(INSTANCE_DATA_BINDING, packet.instanceBuffer, packet.instanceOffset, INSTANCE_BATCH * sizeof(glm::vec4));
+            packet.mesh->DrawElementsInstanced(packet.lod, packet.instanceCount);
+            triangles *= packet.instanceCount;
+        }
+        else
+            packet.mesh->DrawElements(packet.lod);
+        stats.drawCalls++;
+        stats.triangles += triangles;
+    }
+
+    void Add(const DrawPacket& packet)
+    {
+        SortItem item;
+        item.key = packet.key;
+        item.index = (unsigned int)packets.size();
+
+        packets.push_back(packet);
+        order.push_back(item);
+    }
+
+    // adds the state changes one execution of the pass range makes in submission order and in the
+    // sorted order to the statistics, each starting from nothing bound like the executors do.
+    // Depth-only executions switch only between the plain and the instanced program and the
+    // position-only VAOs.
+    void CountStateChanges(Render_Pass firstPass, Render_Pass lastPass, bool depthOnly)
+    {
+        const DrawPacket* submitted = nullptr;
+        const DrawPacket* executed = nullptr;
+        for (unsigned int i = 0; i < order.size(); i++)
+        {
+            uint64_t pass = packets[i].key >> KEY_PASS_SHIFT;
+            if (pass >= (uint64_t)firstPass && pass <= (uint64_t)lastPass)
+            {
+                stats.stateChangesSubmitted += StateChanges(submitted, packets[i], depthOnly);
+                submitted = &packets[i];
+            }
+            pass = order[i].key >> KEY_PASS_SHIFT;
+            if (pass >= (uint64_t)firstPass && pass <= (uint64_t)lastPass)
+            {
+                const DrawPacket& packet = packets[order[i].index];
+                stats.stateChangesExecuted += StateChanges(executed, packet, depthOnly);
+                executed = &packet;
+            }
+        }
+    }
+
+    static unsigned int StateChanges(const DrawPacket* previous, const DrawPacket& packet, bool depthOnly)
+    {
+        unsigned int changes = 0;
+        if (depthOnly)
+        {
+            if (previous == nullptr || (previous->instanceCount > 0) != (packet.instanceCount > 0))
+                changes++;
+            if (previous == nullptr || previous->mesh->depthVAO != packet.mesh->depthVAO)
+                changes++;
+            return changes;
+        }
+        if (previous == nullptr || previous->shader != packet.shader)
+            changes += 2; // program and material
+        else if (!previous->mesh->SameMaterial(*packet.mesh))
+            changes++;
+        if (previous == nullptr || previous->mesh->VAO != packet.mesh->VAO)
+            changes++;
+        return changes;
+    }
+};
+#endif
@@ -0,0 +1,87 @@
+#ifndef RESOLUTION_H
+#define RESOLUTION_H
+
+#include <glm/glm.hpp>
+
+#include <gputimer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+using namespace std;
+
+const float RESOLUTION_MIN_SCALE = 0.5f;
+const float RESOLUTION_MAX_SCALE = 1.0f;
+const float RESOLUTION_SCALE_STEP = 0.05f;   // scales are multiples of this
+const float RESOLUTION_MAX_CHANGE = 0.1f;    // largest scale change of one decision
+const int   RESOLUTION_DECISION_FRAMES = 8;  // frames averaged for one decision
+// between this share of the budget and the budget the scale is kept, below it the scale goes up
+const float RESOLUTION_HEADROOM = 0.8f;
+// sharpening at the minimum scale, it fades out towards the native resolution
+const float RESOLUTION_SHARPNESS = 0.5f;
+
+// Dynamic resolution: picks the fraction of the window size the scene is drawn at, the post
+// processing upscales it to the window. Every few frames the averaged GPU time of the scene
+// passes is compared with the budget. Over budget the scale goes down, well under it the scale
+// goes up, in between it is kept, so the scale does not oscillate around the budget.
+class DynamicResolution
+{
+public:
+    bool Enabled = false;
+    float BudgetMs = 0.0f;
+
+    // size of the scene in pixels for a window size, the window size itself while disabled
+    int SceneSize(int windowSize) const
+    {
+        if (!Enabled) return windowSize;
+        return std::max(1, (int)std::round(windowSize * scale));
+    }
+
+    // strength of the sharpening after the upscale
+    float Sharpness() const
+    {
+        if (!Enabled) return 0.0f;
+        return RESOLUTION_SHARPNESS * (RESOLUTION_MAX_SCALE - scale) / (RESOLUTION_MAX_SCALE - RESOLUTION_MIN_SCALE);
+    }
+
+    float Scale() const
+    {
+        return scale;
+    }
+
+    // called once per frame with the GPU time the scene took
+    void Adapt(float sceneGpuMs)
+    {
+        if (!Enabled) return;
+
+        // timer results arrive a few frames late, frames drawn at the previous scale are skipped
+        frames++;
+        if (frames <= 0) return;
+        gpuMs += sceneGpuMs;
+        if (frames < RESOLUTION_DECISION_FRAMES) return;
+
+        float averageMs = gpuMs / frames;
+        gpuMs = 0.0f;
+        frames = 0;
+        if (averageMs <= BudgetMs && averageMs >= BudgetMs * RESOLUTION_HEADROOM) return;
+
+        // GPU time grows with the pixel count, the square of the scale, aim at the middle of the band
+        float goalMs = BudgetMs * (1.0f + RESOLUTION_HEADROOM) / 2;
+        float wanted = scale * std::sqrt(goalMs / std::max(averageMs, 0.01f));
+        wanted = glm::clamp(wanted, scale - RESOLUTION_MAX_CHANGE, scale + RESOLUTION_MAX_CHANGE);
+        wanted = std::round(wanted / RESOLUTION_SCALE_STEP) * RESOLUTION_SCALE_STEP;
+        wanted = glm::clamp(wanted, RESOLUTION_MIN_SCALE, RESOLUTION_MAX_SCALE);
+        if (std::abs(wanted - scale) < RESOLUTION_SCALE_STEP / 2) return;
+
+        std::cout << "RESOLUTION::SCALE " << scale << " -> " << wanted
+            << " gpu ms: " << averageMs << " budget: " << BudgetMs << std::endl;
+        scale = wanted;
+        frames = -GPU_TIMER_LATENCY;
+    }
+
+private:
+    float scale = RESOLUTION_MAX_SCALE;
+    float gpuMs = 0.0f;
+    int frames = 0;
+};
+#endif
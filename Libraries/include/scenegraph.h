@@ -0,0 +1,123 @@
+#ifndef SCENEGRAPH_H
+#define SCENEGRAPH_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <transforms.h>
+
+#include <vector>
+using namespace std;
+
+const unsigned int SCENE_ROOT        = 0;
+const unsigned int SCENE_NO_INSTANCE = 0xFFFFFFFF;
+
+// Placement hierarchy of the scene: board -> squares -> pieces, lamp, spotlight rig.
+// Every node keeps its world position, rotation and scale and recomputes them only when the node
+// or one of its ancestors changed, then hands the result to the transform store. Parents are
+// always added before their children, so one pass in insertion order updates the whole graph.
+// Scales multiply per axis, which is exact as long as nodes with children are scaled uniformly.
+class SceneGraph
+{
+public:
+    // nodes recomputed by the last Update
+    unsigned int Recomputed = 0;
+
+    SceneGraph()
+    {
+        Node root;
+        root.parent = SCENE_ROOT;
+        root.localPosition = root.worldPosition = glm::vec3(0.0f);
+        root.localRotation = root.worldRotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+        root.localScale = root.worldScale = glm::vec3(1.0f);
+        root.instance = SCENE_NO_INSTANCE;
+        root.dirty = false;
+        root.changed = false;
+        nodes.push_back(root);
+    }
+
+    // with an instance the node also gets model and normal matrices in the transform store
+    unsigned int AddNode(unsigned int parent, glm::vec3 position, glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3 scale = glm::vec3(1.0f), bool hasInstance = false)
+    {
+        Node node;
+        node.parent = parent;
+        node.localPosition = position;
+        node.localRotation = rotation;
+        node.localScale = scale;
+        node.instance = hasInstance ? transformStore.Add(glm::vec3(0.0f), rotation, scale) : SCENE_NO_INSTANCE;
+        node.dirty = true;
+        node.changed = false;
+        nodes.push_back(node);
+        return (unsigned int)nodes.size() - 1;
+    }
+
+    // setting the value a node already has leaves it clean, callers may set every frame
+    void SetPosition(unsigned int node, glm::vec3 position)
+    {
+        if (nodes[node].localPosition == position) return;
+        nodes[node].localPosition = position;
+        nodes[node].dirty = true;
+    }
+
+    void SetRotation(unsigned int node, glm::quat rotation)
+    {
+        if (nodes[node].localRotation == rotation) return;
+        nodes[node].localRotation = rotation;
+        nodes[node].dirty = true;
+    }
+
+    // recomputes the changed subtrees and composes their matrices, a frame without changes does no transform work
+    void Update()
+    {
+        Recomputed = 0;
+        for (unsigned int i = 1; i < nodes.size(); i++)
+        {
+            Node& node = nodes[i];
+            const Node& parent = nodes[node.parent];
+            node.changed = node.dirty || parent.changed;
+            if (!node.changed) continue;
+
+            node.worldRotation = parent.worldRotation * node.localRotation;
+            node.worldScale = parent.worldScale * node.localScale;
+            node.worldPosition = parent.worldPosition + parent.worldRotation * (parent.worldScale * node.localPosition);
+            node.dirty = false;
+            if (node.instance != SCENE_NO_INSTANCE)
+                transformStore.Set(node.instance, node.worldPosition, node.worldRotation, node.worldScale);
+            Recomputed++;
+        }
+        if (Recomputed > 0)
+            transformStore.Update();
+    }
+
+    glm::vec3 WorldPosition(unsigned int node) const
+    {
+        return nodes[node].worldPosition;
+    }
+
+    unsigned int Instance(unsigned int node) const
+    {
+        return nodes[node].instance;
+    }
+
+    // true if the last Update moved the node, for example to refresh its bounds
+    bool Changed(unsigned int node) const
+    {
+        return nodes[node].changed;
+    }
+
+private:
+    struct Node {
+        unsigned int parent;
+        glm::vec3 localPosition, worldPosition;
+        glm::quat localRotation, worldRotation;
+        glm::vec3 localScale, worldScale;
+        unsigned int instance;
+        bool dirty;
+        bool changed;
+    };
+
+    vector<Node> nodes;
+};
+
+SceneGraph sceneGraph;
+#endif
@@ -4,10 +4,29 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include <glstate.h>
+#include <programcache.h>
+
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <atomic>
+#include <cstdint>
+#include <set>
+#include <vector>
+
+// COMPILE_LATER only preprocesses the sources and checks the binary cache, IssueCompile and
+// FinishCompile are called later, possibly by a ShaderCompiler on another context.
+enum Shader_Compile {
+    COMPILE_NOW,
+    COMPILE_LATER
+};
+
+// binding point of the per draw uniform block (Shaders/draw_data.glsl), filled by the render queue
+const unsigned int DRAW_DATA_BINDING = 0;
+// binding point of the instance offsets of instanced variants, filled by the render queue
+const unsigned int INSTANCE_DATA_BINDING = 1;
 
 class Shader
 {
@@ -16,91 +35,108 @@ public:
     // constructor generates the shader on the fly
     // ------------------------------------------------------------------------
     Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
+        : Shader(vertexPath, fragmentPath, std::vector<std::string>(), COMPILE_NOW, geometryPath)
     {
-        // 1. retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
-        std::string geometryCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        std::ifstream gShaderFile;
-        // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        gShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        try
-        {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();
-            // if geometry shader path is present, also load a geometry shader
-            if (geometryPath != nullptr)
-            {
-                gShaderFile.open(geometryPath);
-                std::stringstream gShaderStream;
-                gShaderStream << gShaderFile.rdbuf();
-                gShaderFile.close();
-                geometryCode = gShaderStream.str();
-            }
-        }
-        catch (std::ifstream::failure& e)
+    }
+    // constructor of a specialized variant, every define is injected after the #version line
+    // ------------------------------------------------------------------------
+    Shader(const char* vertexPath, const char* fragmentPath, const std::vector<std::string>& defines, Shader_Compile compile = COMPILE_NOW, const char* geometryPath = nullptr)
+    {
+        ready = false;
+        blocksBound = false;
+        vertex = fragment = geometry = 0;
+        hasGeometry = geometryPath != nullptr;
+        // 1. retrieve the vertex/fragment source code from filePath, with the includes resolved
+        vertexCode = Preprocess(vertexPath, defines);
+        fragmentCode = Preprocess(fragmentPath, defines);
+        // if geometry shader path is present, also load a geometry shader
+        if (hasGeometry)
+            geometryCode = Preprocess(geometryPath, defines);
+        // 2. use the linked binary of an earlier run if the sources, defines and driver are unchanged
+        ID = glCreateProgram();
+        cacheKey = programBinaryCache.MakeKey({ vertexCode, fragmentCode, geometryCode }, defines);
+        if (programBinaryCache.Load(ID, cacheKey))
         {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+            ReleaseSources();
+            ready = true;
+            return;
         }
+        if (compile == COMPILE_LATER)
+            return;
+        IssueCompile();
+        FinishCompile();
+    }
+    // 3. hands the sources to the driver without asking for any result, so a driver with
+    // GL_KHR_parallel_shader_compile can compile and link in the background
+    // ------------------------------------------------------------------------
+    void IssueCompile()
+    {
         const char* vShaderCode = vertexCode.c_str();
         const char* fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
-        unsigned int vertex, fragment;
         // vertex shader
         vertex = glCreateShader(GL_VERTEX_SHADER);
         glShaderSource(vertex, 1, &vShaderCode, NULL);
         glCompileShader(vertex);
-        CheckCompileErrors(vertex, "VERTEX");
         // fragment Shader
         fragment = glCreateShader(GL_FRAGMENT_SHADER);
         glShaderSource(fragment, 1, &fShaderCode, NULL);
         glCompileShader(fragment);
-        CheckCompileErrors(fragment, "FRAGMENT");
         // if geometry shader is given, compile geometry shader
-        unsigned int geometry;
-        if (geometryPath != nullptr)
+        if (hasGeometry)
         {
             const char* gShaderCode = geometryCode.c_str();
             geometry = glCreateShader(GL_GEOMETRY_SHADER);
             glShaderSource(geometry, 1, &gShaderCode, NULL);
             glCompileShader(geometry);
-            CheckCompileErrors(geometry, "GEOMETRY");
         }
         // shader Program
-        ID = glCreateProgram();
         glAttachShader(ID, vertex);
         glAttachShader(ID, fragment);
-        if (geometryPath != nullptr)
+        if (hasGeometry)
             glAttachShader(ID, geometry);
+        programBinaryCache.PrepareForStore(ID);
         glLinkProgram(ID);
-        CheckCompileErrors(ID, "PROGRAM");
+    }
+    // 4. checks the results and stores the binary, waits for the driver if it is not done yet
+    // ------------------------------------------------------------------------
+    void FinishCompile()
+    {
+        CheckCompileErrors(vertex, "VERTEX");
+        CheckCompileErrors(fragment, "FRAGMENT");
+        if (hasGeometry)
+            CheckCompileErrors(geometry, "GEOMETRY");
+        if (CheckCompileErrors(ID, "PROGRAM"))
+            programBinaryCache.Store(ID, cacheKey);
         // delete the shaders as they're linked into our program now and no longer necessery
         glDeleteShader(vertex);
         glDeleteShader(fragment);
-        if (geometryPath != nullptr)
+        if (hasGeometry)
             glDeleteShader(geometry);
-
+        ReleaseSources();
+        ready = true;
+    }
+    // false while a COMPILE_LATER program is still being compiled
+    // ------------------------------------------------------------------------
+    bool Ready() const
+    {
+        return ready;
     }
     // activate the shader
     // ------------------------------------------------------------------------
     void Use()
     {
-        glUseProgram(ID);
+        // block bindings are reset by every link and binary load, the program is final once it is used
+        if (!blocksBound)
+        {
+            unsigned int drawData = glGetUniformBlockIndex(ID, "DrawData");
+            if (drawData != GL_INVALID_INDEX)
+                glUniformBlockBinding(ID, drawData, DRAW_DATA_BINDING);
+            unsigned int instanceData = glGetUniformBlockIndex(ID, "InstanceData");
+            if (instanceData != GL_INVALID_INDEX)
+                glUniformBlockBinding(ID, instanceData, INSTANCE_DATA_BINDING);
+            blocksBound = true;
+        }
+        glState.UseProgram(ID);
     }
     // utility uniform functions
     // ------------------------------------------------------------------------
@@ -161,10 +197,95 @@ public:
         glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
     }
 
+    // reads a shader file, inserts the defines after its #version line and replaces every
+    // #include "file" line with that file, paths are relative to the including file.
+    // Each file is included once, #line directives keep the error line numbers per file.
+    // ------------------------------------------------------------------------
+    static std::string Preprocess(const std::string& path, const std::vector<std::string>& defines)
+    {
+        std::set<std::string> included;
+        included.insert(path);
+        return LoadSource(path, defines, included, 0);
+    }
+
 private:
-    // utility function for checking shader compilation/linking errors.
+    std::atomic<bool> ready;
+    bool blocksBound;
+    bool hasGeometry;
+    unsigned int vertex, fragment, geometry;
+    std::string vertexCode, fragmentCode, geometryCode;
+    uint64_t cacheKey;
+
+    void ReleaseSources()
+    {
+        std::string().swap(vertexCode);
+        std::string().swap(fragmentCode);
+        std::string().swap(geometryCode);
+    }
+
+    static std::string LoadSource(const std::string& path, const std::vector<std::string>& defines, std::set<std::string>& included, int sourceNumber)
+    {
+        std::string code;
+        std::ifstream shaderFile;
+        // ensure ifstream objects can throw exceptions:
+        shaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+        try
+        {
+            shaderFile.open(path);
+            std::stringstream shaderStream;
+            shaderStream << shaderFile.rdbuf();
+            shaderFile.close();
+            code = shaderStream.str();
+        }
+        catch (std::ifstream::failure& e)
+        {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << path << std::endl;
+            return "";
+        }
+
+        std::string directory = path.substr(0, path.find_last_of("/\\") + 1);
+        std::stringstream output;
+        std::istringstream lines(code);
+        std::string line;
+        int lineNumber = 0;
+        while (std::getline(lines, line))
+        {
+            lineNumber++;
+            size_t start = line.find_first_not_of(" \t");
+            if (start != std::string::npos && line.compare(start, 8, "#version") == 0)
+            {
+                output << line << "\n";
+                for (const std::string& define : defines)
+                    output << "#define " << define << "\n";
+                output << "#line " << lineNumber + 1 << " " << sourceNumber << "\n";
+            }
+            else if (start != std::string::npos && line.compare(start, 8, "#include") == 0)
+            {
+                size_t open = line.find('"', start);
+                size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+                if (close == std::string::npos)
+                {
+                    std::cout << "ERROR::SHADER::INVALID_INCLUDE: " << path << "(" << lineNumber << ")" << std::endl;
+                    continue;
+                }
+                std::string includePath = directory + line.substr(open + 1, close - open - 1);
+                if (included.insert(includePath).second)
+                {
+                    int includeNumber = (int)included.size() - 1;
+                    output << "#line 1 " << includeNumber << "\n";
+                    output << LoadSource(includePath, std::vector<std::string>(), included, includeNumber) << "\n";
+                }
+                output << "#line " << lineNumber + 1 << " " << sourceNumber << "\n";
+            }
+            else
+                output << line << "\n";
+        }
+        return output.str();
+    }
+
+    // utility function for checking shader compilation/linking errors, returns true on success.
     // ------------------------------------------------------------------------
-    void CheckCompileErrors(GLuint shader, std::string type)
+    bool CheckCompileErrors(GLuint shader, std::string type)
     {
         GLint success;
         GLchar infoLog[1024];
@@ -186,6 +307,7 @@ private:
                 std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
             }
         }
+        return success != 0;
     }
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,103 @@
+#ifndef SHADERCACHE_H
+#define SHADERCACHE_H
+
+#include <shader.h>
+#include <shadercompiler.h>
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Switches compiled into the lighting shaders instead of being branched on per fragment.
+enum Shader_Feature {
+    FEATURE_BLINN     = 1 << 0,
+    FEATURE_SPOTLIGHT = 1 << 1,
+    FEATURE_SHADOWS   = 1 << 2,
+    FEATURE_INSTANCED = 1 << 3   // the tournament hall draws every board of a batch with one call
+};
+
+const int SHADER_FEATURE_COUNT = 4;
+const char* const SHADER_FEATURE_DEFINES[SHADER_FEATURE_COUNT] = {
+    "USE_BLINN",
+    "SPOTLIGHT_ON",
+    "USE_SHADOWS",
+    "INSTANCED"
+};
+
+// Compiled programs keyed by their source files and defines. Every combination is compiled once,
+// shaders asking for the same sources and defines share one program. With a compiler the
+// programs are compiled in the background and may not be Ready when Get returns.
+class ShaderCache
+{
+public:
+    ShaderCache(ShaderCompiler* compiler = nullptr)
+    {
+        this->compiler = compiler;
+    }
+
+    Shader& Get(const string& vertexPath, const string& fragmentPath, const vector<string>& defines)
+    {
+        // the order of the defines does not change the program
+        vector<string> sortedDefines = defines;
+        std::sort(sortedDefines.begin(), sortedDefines.end());
+        string key = vertexPath + "|" + fragmentPath;
+        for (const string& define : sortedDefines)
+            key += "|" + define;
+
+        auto found = programs.find(key);
+        if (found != programs.end())
+            return *found->second;
+
+        Shader* shader = new Shader(vertexPath.c_str(), fragmentPath.c_str(), defines, compiler != nullptr ? COMPILE_LATER : COMPILE_NOW);
+        programs[key] = unique_ptr<Shader>(shader);
+        if (compiler != nullptr)
+            compiler->Submit(*shader);
+        return *shader;
+    }
+
+    Shader& Get(const string& vertexPath, const string& fragmentPath, unsigned int features)
+    {
+        return Get(vertexPath, fragmentPath, FeatureDefines(features));
+    }
+
+    // the requested variant, or the fallback while that one is still compiling
+    Shader& GetReady(const string& vertexPath, const string& fragmentPath, unsigned int features, Shader& fallback)
+    {
+        Shader& shader = Get(vertexPath, fragmentPath, features);
+        return shader.Ready() ? shader : fallback;
+    }
+
+    // compiles every combination of the given features up front, so toggling never compiles
+    void Prebuild(const string& vertexPath, const string& fragmentPath, unsigned int features)
+    {
+        // walks all subsets of the feature bits, starting from the empty one
+        unsigned int subset = 0;
+        do
+        {
+            Get(vertexPath, fragmentPath, subset);
+            subset = (subset - features) & features;
+        } while (subset != 0);
+    }
+
+    unsigned int Size() const
+    {
+        return (unsigned int)programs.size();
+    }
+
+    static vector<string> FeatureDefines(unsigned int features)
+    {
+        vector<string> defines;
+        for (int i = 0; i < SHADER_FEATURE_COUNT; i++)
+            if (features & (1u << i))
+                defines.push_back(SHADER_FEATURE_DEFINES[i]);
+        return defines;
+    }
+
+private:
+    ShaderCompiler* compiler;
+    map<string, unique_ptr<Shader>> programs;
+};
+#endif
@@ -0,0 +1,189 @@
+#ifndef SHADERCOMPILER_H
+#define SHADERCOMPILER_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <shader.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+using namespace std;
+
+// GL_KHR_parallel_shader_compile (and its ARB twin), not part of the 3.3 glad loader
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR           0x91B1
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
+enum Compile_Mode {
+    COMPILE_MODE_SYNCHRONOUS     = 0,
+    COMPILE_MODE_PARALLEL_KHR    = 1,
+    COMPILE_MODE_WORKER_THREAD   = 2
+};
+
+// Compiles COMPILE_LATER shaders off the critical path. With GL_KHR_parallel_shader_compile the
+// compiles are issued at once and polled with GL_COMPLETION_STATUS_KHR every frame. Without it a
+// worker thread owns a hidden window whose context shares objects with the main one and compiles
+// there. Until a program is Ready the renderer keeps drawing with a fallback program.
+class ShaderCompiler
+{
+public:
+    Compile_Mode Mode = COMPILE_MODE_SYNCHRONOUS;
+
+    ~ShaderCompiler()
+    {
+        StopWorker();
+    }
+
+    // has to run on the main thread with the main context current
+    void Init(GLFWwindow* window)
+    {
+        if (HasExtension("GL_KHR_parallel_shader_compile") || HasExtension("GL_ARB_parallel_shader_compile"))
+        {
+            PFNGLMAXSHADERCOMPILERTHREADSKHRPROC maxShaderCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+            if (maxShaderCompilerThreads == nullptr)
+                maxShaderCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)glfwGetProcAddress("glMaxShaderCompilerThreadsARB");
+            // let the driver pick the number of threads
+            if (maxShaderCompilerThreads != nullptr)
+                maxShaderCompilerThreads(0xFFFFFFFF);
+            Mode = COMPILE_MODE_PARALLEL_KHR;
+            return;
+        }
+
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        workerWindow = glfwCreateWindow(1, 1, "Shader compiler", NULL, window);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+        if (workerWindow == NULL)
+        {
+            std::cout << "ERROR::SHADER_COMPILER::SHARED_CONTEXT_NOT_CREATED" << std::endl;
+            return;
+        }
+        // creating the window does not make its context current, the worker thread takes it
+        stopWorker = false;
+        worker = thread(&ShaderCompiler::WorkerLoop, this);
+        Mode = COMPILE_MODE_WORKER_THREAD;
+    }
+
+    void Submit(Shader& shader)
+    {
+        if (shader.Ready()) return;
+
+        switch (Mode)
+        {
+        case COMPILE_MODE_PARALLEL_KHR:
+            shader.IssueCompile();
+            pending.push_back(&shader);
+            pendingCount++;
+            break;
+        case COMPILE_MODE_WORKER_THREAD:
+        {
+            lock_guard<mutex> lock(queueMutex);
+            queue.push_back(&shader);
+            pendingCount++;
+            queueChanged.notify_one();
+            break;
+        }
+        default:
+            shader.IssueCompile();
+            shader.FinishCompile();
+            break;
+        }
+    }
+
+    // called once per frame on the main thread, finishes the programs the driver is done with
+    void Poll()
+    {
+        if (Mode != COMPILE_MODE_PARALLEL_KHR) return;
+
+        for (unsigned int i = 0; i < pending.size();)
+        {
+            GLint completed = GL_FALSE;
+            glGetProgramiv(pending[i]->ID, GL_COMPLETION_STATUS_KHR, &completed);
+            if (completed)
+            {
+                pending[i]->FinishCompile();
+                pending[i] = pending.back();
+                pending.pop_back();
+                pendingCount--;
+            }
+            else
+                i++;
+        }
+    }
+
+    // programs still compiling
+    unsigned int Pending() const
+    {
+        return pendingCount;
+    }
+
+    // stops the worker and destroys its window, has to be called before glfwTerminate
+    void Shutdown()
+    {
+        StopWorker();
+        if (workerWindow != NULL)
+        {
+            glfwDestroyWindow(workerWindow);
+            workerWindow = NULL;
+        }
+    }
+
+private:
+    GLFWwindow* workerWindow = NULL;
+    thread worker;
+    mutex queueMutex;
+    condition_variable queueChanged;
+    deque<Shader*> queue;
+    bool stopWorker = false;
+    vector<Shader*> pending;
+    atomic<unsigned int> pendingCount{ 0 };
+
+    static bool HasExtension(const char* name)
+    {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; i++)
+            if (std::strcmp((const char*)glGetStringi(GL_EXTENSIONS, i), name) == 0)
+                return true;
+        return false;
+    }
+
+    void WorkerLoop()
+    {
+        glfwMakeContextCurrent(workerWindow);
+        while (true)
+        {
+            Shader* shader;
+            {
+                unique_lock<mutex> lock(queueMutex);
+                queueChanged.wait(lock, [this] { return stopWorker || !queue.empty(); });
+                if (stopWorker) break;
+                shader = queue.front();
+                queue.pop_front();
+            }
+            shader->IssueCompile();
+            // the program has to be complete before the main context may use it
+            glFinish();
+            shader->FinishCompile();
+            pendingCount--;
+        }
+        glfwMakeContextCurrent(NULL);
+    }
+
+    void StopWorker()
+    {
+        if (!worker.joinable()) return;
+        {
+            lock_guard<mutex> lock(queueMutex);
+            stopWorker = true;
+        }
+        queueChanged.notify_one();
+        worker.join();
+    }
+};
+#endif
@@ -0,0 +1,199 @@
+#ifndef SHADOWS_H
+#define SHADOWS_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <shader.h>
+#include <glstate.h>
+#include <bounds.h>
+#include <renderqueue.h>
+#include <entities.h>
+
+#include <cmath>
+#include <string>
+using namespace std;
+
+const int   LAMP_SHADOW_SIZE          = 1024;
+const float LAMP_SHADOW_FAR           = 25.0f;
+const int   SPOTLIGHT_SHADOW_SIZE     = 512;
+const float SPOTLIGHT_SHADOW_FAR      = 20.0f;
+const float SHADOW_NEAR               = 0.1f;
+
+// texture units of the shadow maps, above the units of materials and clustered lighting
+const unsigned int SPOTLIGHT_SHADOW_UNIT = 11;
+const unsigned int LAMP_SHADOW_UNIT      = 12;
+
+// Shadow maps of the lamp and the spotlight, the board and the pieces are the casters.
+// The lamp casts into a cube map of linear distances. It only holds static casters and is cached:
+// it is re-rendered when the lamp or any shadow caster moves. The spotlight orbits the
+// board, so its perspective map is re-rendered every frame, at a lower resolution to keep it cheap.
+class ShadowMaps
+{
+public:
+    // number of times the cached lamp cube map had to be rebuilt
+    unsigned int LampRenders = 0;
+
+    ShadowMaps(const char* shaderDirectory, int spotlightSize = SPOTLIGHT_SHADOW_SIZE)
+        : cubeShader((string(shaderDirectory) + "shadow_depth_shader.vert").c_str(), (string(shaderDirectory) + "shadow_depth_shader.frag").c_str()),
+          spotlightShader((string(shaderDirectory) + "depth_prepass_shader.vert").c_str(), (string(shaderDirectory) + "depth_prepass_shader.frag").c_str())
+    {
+        spotlightResolution = spotlightSize;
+        lampValid = false;
+        spotlightLightSpace = glm::mat4(1.0f);
+
+        glGenFramebuffers(1, &framebuffer);
+        glState.BindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        glState.BindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        SetupSpotlightMap();
+        SetupLampMap();
+    }
+
+    // re-renders the lamp cube map if the lamp or any caster moved since the last time
+    void UpdateLamp(EntityStore& casters, glm::vec3 lightPos)
+    {
+        unsigned int castersVersion = casters.CastersVersion();
+        if (lampValid && castersVersion == lampCastersVersion && lightPos == lampPosition)
+            return;
+        lampValid = true;
+        lampCastersVersion = castersVersion;
+        lampPosition = lightPos;
+        LampRenders++;
+
+        casterQueue.Begin(lightPos);
+        casters.SubmitShadowCasters(casterQueue, cubeShader);
+        casterQueue.Sort();
+
+        // one 90 degree view per face, the up vectors follow the cube map face orientation
+        const glm::vec3 directions[6] = {
+            glm::vec3(1, 0, 0), glm::vec3(-1, 0, 0), glm::vec3(0, 1, 0),
+            glm::vec3(0, -1, 0), glm::vec3(0, 0, 1), glm::vec3(0, 0, -1)
+        };
+        const glm::vec3 ups[6] = {
+            glm::vec3(0, -1, 0), glm::vec3(0, -1, 0), glm::vec3(0, 0, 1),
+            glm::vec3(0, 0, -1), glm::vec3(0, -1, 0), glm::vec3(0, -1, 0)
+        };
+        glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, SHADOW_NEAR, LAMP_SHADOW_FAR);
+
+        BeginPass(LAMP_SHADOW_SIZE);
+        cubeShader.Use();
+        cubeShader.SetVec3("lightPos", lightPos);
+        cubeShader.SetFloat("farPlane", LAMP_SHADOW_FAR);
+        for (int face = 0; face < 6; face++)
+        {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, lampMap, 0);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            cubeShader.SetMat4("projection", projection);
+            cubeShader.SetMat4("view", glm::lookAt(lightPos, lightPos + directions[face], ups[face]));
+            casterQueue.ExecuteDepthOnly(cubeShader);
+        }
+        EndPass();
+    }
+
+    // renders the spotlight map, only the casters inside the light cone are drawn
+    void UpdateSpotlight(EntityStore& casters, glm::vec3 lightPos, glm::vec3 direction, float outerCutOff)
+    {
+        float fov = 2.0f * std::acos(outerCutOff) + glm::radians(5.0f);
+        glm::mat4 projection = glm::perspective(fov, 1.0f, SHADOW_NEAR, SPOTLIGHT_SHADOW_FAR);
+        glm::mat4 view = glm::lookAt(lightPos, lightPos + direction, glm::vec3(0, 1, 0));
+        spotlightLightSpace = projection * view;
+        Frustum frustum(spotlightLightSpace);
+
+        casterQueue.Begin(lightPos);
+        casters.SubmitShadowCasters(casterQueue, spotlightShader, &frustum);
+        casterQueue.Sort();
+
+        BeginPass(spotlightResolution);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, spotlightMap, 0);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        // slope scaled bias against shadow acne, the cube map biases its linear distances in the shader
+        glState.Enable(GL_POLYGON_OFFSET_FILL);
+        glPolygonOffset(2.0f, 4.0f);
+        spotlightShader.Use();
+        spotlightShader.SetMat4("projection", projection);
+        spotlightShader.SetMat4("view", view);
+        casterQueue.ExecuteDepthOnly(spotlightShader);
+        glState.Disable(GL_POLYGON_OFFSET_FILL);
+        EndPass();
+    }
+
+    // binds the maps for a shader variant compiled with USE_SHADOWS
+    void Bind(Shader& shader)
+    {
+        shader.Use();
+        glState.BindTexture(SPOTLIGHT_SHADOW_UNIT, GL_TEXTURE_2D, spotlightMap);
+        glState.BindTexture(LAMP_SHADOW_UNIT, GL_TEXTURE_CUBE_MAP, lampMap);
+        shader.SetInt("spotlightShadowMap", SPOTLIGHT_SHADOW_UNIT);
+        shader.SetInt("lampShadowMap", LAMP_SHADOW_UNIT);
+        shader.SetMat4("spotlightLightSpace", spotlightLightSpace);
+        shader.SetFloat("lampShadowFar", LAMP_SHADOW_FAR);
+    }
+
+private:
+    Shader cubeShader;
+    Shader spotlightShader;
+    RenderQueue casterQueue;
+    unsigned int framebuffer;
+    unsigned int lampMap, spotlightMap;
+    int spotlightResolution;
+    glm::mat4 spotlightLightSpace;
+
+    bool lampValid;
+    unsigned int lampCastersVersion;
+    glm::vec3 lampPosition;
+
+    GLint savedViewport[4];
+
+    void BeginPass(int size)
+    {
+        glGetIntegerv(GL_VIEWPORT, savedViewport);
+        glState.BindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glViewport(0, 0, size, size);
+    }
+
+    void EndPass()
+    {
+        glState.BindFramebuffer(GL_FRAMEBUFFER, glState.SceneFramebuffer);
+        glViewport(savedViewport[0], savedViewport[1], savedViewport[2], savedViewport[3]);
+    }
+
+    // depth comparison in the sampler, texture() returns the lit fraction with bilinear filtering
+    static void SetCompareMode(GLenum target)
+    {
+        glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(target, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTexParameteri(target, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    }
+
+    void SetupSpotlightMap()
+    {
+        glGenTextures(1, &spotlightMap);
+        glState.BindTexture(SPOTLIGHT_SHADOW_UNIT, GL_TEXTURE_2D, spotlightMap);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, spotlightResolution, spotlightResolution, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+        SetCompareMode(GL_TEXTURE_2D);
+        // outside of the light frustum nothing is shadowed
+        float border[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+        glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, border);
+    }
+
+    void SetupLampMap()
+    {
+        glGenTextures(1, &lampMap);
+        glState.BindTexture(LAMP_SHADOW_UNIT, GL_TEXTURE_CUBE_MAP, lampMap);
+        for (int face = 0; face < 6; face++)
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_DEPTH_COMPONENT24, LAMP_SHADOW_SIZE, LAMP_SHADOW_SIZE, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+        SetCompareMode(GL_TEXTURE_CUBE_MAP);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    }
+};
+#endif
@@ -0,0 +1,231 @@
+#ifndef STREAMBUFFER_H
+#define STREAMBUFFER_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <glstate.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <vector>
+using namespace std;
+
+// GL_ARB_buffer_storage, core since OpenGL 4.4, so glad for 3.3 does not load it
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT   0x0080
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+const unsigned int STREAM_BUFFER_FRAMES     = 3;
+const unsigned int STREAM_BUFFER_FRAME_SIZE = 1 << 20;
+// the storage reaches this far past the last region, so a block bound with a fixed size larger
+// than the data written at its offset still lies inside the buffer
+const unsigned int STREAM_BUFFER_RANGE_SLACK = 16384;
+// a fence is polled in steps of this many nanoseconds until the GPU releases the region
+const GLuint64 STREAM_BUFFER_WAIT_STEP_NS   = 1000000;
+
+// Per-frame dynamic data written by the CPU with plain stores. With GL_ARB_buffer_storage one
+// buffer holds a region for each of three frames and stays mapped, persistent and coherent, for
+// its whole life. A fence placed after a frame guards its region, which is written again only
+// once the GPU is done with it, so writing never waits unless the GPU is three frames behind.
+// Without the extension the frame is staged in memory and uploaded with glBufferSubData into
+// storage that is orphaned at the start of every frame. A frame that needs more than its region
+// grows the buffer, the frames after it have room again. The buffer it replaces is only deleted
+// at the end of the frame, draws recorded earlier in the frame may still refer to data in it.
+class StreamBuffer
+{
+public:
+    bool PersistentMapping = true;
+
+    // loads the entry point and creates the storage, needs the context of the thread drawing
+    void Init(GLADloadproc loader)
+    {
+        bufferStorage = (PFNGLBUFFERSTORAGEPROC)loader("glBufferStorage");
+        persistent = PersistentMapping && bufferStorage != nullptr && HasBufferStorage();
+
+        GLint alignment = 0;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        uniformAlignment = (unsigned int)std::max(alignment, 16);
+        CreateStorage(STREAM_BUFFER_FRAME_SIZE);
+    }
+
+    bool Persistent() const
+    {
+        return persistent;
+    }
+
+    unsigned int Buffer() const
+    {
+        return buffer;
+    }
+
+    // counts the frames, data allocated in an earlier frame may already be overwritten
+    unsigned int Frame() const
+    {
+        return frame;
+    }
+
+    // time the last BeginFrame waited for the GPU to release the region
+    float WaitMs() const
+    {
+        return waitMs;
+    }
+
+    // bytes between consecutive blocks of the given size bound as separate uniform ranges
+    unsigned int UniformStride(unsigned int size) const
+    {
+        return (size + uniformAlignment - 1) / uniformAlignment * uniformAlignment;
+    }
+
+    void BeginFrame()
+    {
+        frame++;
+        waitMs = 0.0f;
+        if (persistent)
+        {
+            region = (region + 1) % STREAM_BUFFER_FRAMES;
+            if (fences[region] != 0)
+            {
+                if (glClientWaitSync(fences[region], 0, 0) == GL_TIMEOUT_EXPIRED)
+                {
+                    float waitStart = (float)glfwGetTime();
+                    while (glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, STREAM_BUFFER_WAIT_STEP_NS) == GL_TIMEOUT_EXPIRED) {}
+                    waitMs = 1000.0f * ((float)glfwGetTime() - waitStart);
+                }
+                glDeleteSync(fences[region]);
+                fences[region] = 0;
+            }
+            head = region * frameSize;
+        }
+        else
+        {
+            head = 0;
+            flushed = 0;
+            glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+            glBufferData(GL_UNIFORM_BUFFER, frameSize + STREAM_BUFFER_RANGE_SLACK, NULL, GL_STREAM_DRAW);
+        }
+    }
+
+    // called after the last draw reading this frame's data
+    void EndFrame()
+    {
+        if (persistent)
+            fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        if (!retired.empty())
+        {
+            glDeleteBuffers((GLsizei)retired.size(), &retired[0]);
+            retired.clear();
+            // deleting unbinds them and a new buffer may reuse their names, the cached bindings cannot be trusted
+            glState.Invalidate();
+        }
+    }
+
+    // memory for size bytes of this frame, to be written only, offset gets their place in the buffer
+    void* Allocate(unsigned int size, unsigned int& offset)
+    {
+        unsigned int start = (head + uniformAlignment - 1) / uniformAlignment * uniformAlignment;
+        unsigned int regionEnd = (persistent ? region * frameSize : 0) + frameSize;
+        if (start + size > regionEnd)
+        {
+            Grow(std::max(2 * frameSize, size + uniformAlignment));
+            start = head;
+        }
+        head = start + size;
+        offset = start;
+        return persistent ? mapped + start : &staging[start];
+    }
+
+    // makes the data allocated since the last call visible to the GPU, coherent mappings need nothing
+    void Flush()
+    {
+        if (persistent || head == flushed) return;
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, flushed, head - flushed, &staging[flushed]);
+        flushed = head;
+    }
+
+private:
+    PFNGLBUFFERSTORAGEPROC bufferStorage = nullptr;
+    bool persistent = false;
+    unsigned int buffer = 0;
+    unsigned char* mapped = nullptr;
+    vector<unsigned char> staging;
+    vector<unsigned int> retired;
+    GLsync fences[STREAM_BUFFER_FRAMES] = {};
+    unsigned int frameSize = 0;
+    unsigned int uniformAlignment = 256;
+    unsigned int region = 0;
+    unsigned int head = 0;
+    unsigned int flushed = 0;
+    unsigned int frame = 0;
+    float waitMs = 0.0f;
+
+    static bool HasBufferStorage()
+    {
+        GLint major = 0, minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        if (major > 4 || (major == 4 && minor >= 4))
+            return true;
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; i++)
+            if (std::strcmp((const char*)glGetStringi(GL_EXTENSIONS, i), "GL_ARB_buffer_storage") == 0)
+                return true;
+        return false;
+    }
+
+    void CreateStorage(unsigned int size)
+    {
+        frameSize = size;
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        if (persistent)
+        {
+            const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            GLsizeiptr storage = (GLsizeiptr)frameSize * STREAM_BUFFER_FRAMES + STREAM_BUFFER_RANGE_SLACK;
+            bufferStorage(GL_UNIFORM_BUFFER, storage, NULL, flags);
+            mapped = (unsigned char*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, storage, flags);
+            if (mapped == nullptr)
+            {
+                std::cout << "ERROR::STREAM_BUFFER::MAP_FAILED falling back to orphaning" << std::endl;
+                glDeleteBuffers(1, &buffer);
+                persistent = false;
+                CreateStorage(size);
+                return;
+            }
+        }
+        else
+        {
+            staging.resize(frameSize);
+            glBufferData(GL_UNIFORM_BUFFER, frameSize + STREAM_BUFFER_RANGE_SLACK, NULL, GL_STREAM_DRAW);
+        }
+    }
+
+    // replaces the buffer with a larger one in the middle of a frame. Draws already issued keep
+    // reading the old storage, the driver releases it once they are done after EndFrame deleted it.
+    void Grow(unsigned int size)
+    {
+        std::cout << "STREAM_BUFFER::GROW frame size: " << size << std::endl;
+        if (persistent)
+        {
+            glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+            glUnmapBuffer(GL_UNIFORM_BUFFER);
+            for (GLsync& fence : fences)
+            {
+                if (fence != 0)
+                    glDeleteSync(fence);
+                fence = 0;
+            }
+        }
+        retired.push_back(buffer);
+        CreateStorage(size);
+        region = 0;
+        head = 0;
+        flushed = 0;
+    }
+};
+
+StreamBuffer streamBuffer;
+#endif
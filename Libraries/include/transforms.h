@@ -0,0 +1,163 @@
+#ifndef TRANSFORMS_H
+#define TRANSFORMS_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <jobs.h>
+
+#include <xmmintrin.h>
+
+#include <cstring>
+#include <vector>
+using namespace std;
+
+const unsigned int TRANSFORM_BATCH = 4;
+// batches per job, fewer dirty batches are composed on the calling thread
+const unsigned int TRANSFORM_JOB_GRAIN = 64;
+
+// Position, rotation and scale of every scene object, stored as separate arrays so four
+// transforms are composed at once with SSE. Only batches touched since the last Update are
+// composed again. Next to the model matrix the normal matrix is kept, the inverse transpose of
+// rotation * scale is rotation * (1 / scale), so no shader has to invert the model per vertex.
+class TransformStore
+{
+public:
+    // transforms composed by the last Update, a multiple of the batch size
+    unsigned int Recomposed = 0;
+
+    unsigned int Add(glm::vec3 position, glm::quat rotation, glm::vec3 scale)
+    {
+        unsigned int id = count++;
+        if (id % TRANSFORM_BATCH == 0)
+            Grow();
+        Set(id, position, rotation, scale);
+        return id;
+    }
+
+    void Set(unsigned int id, glm::vec3 position, glm::quat rotation, glm::vec3 scale)
+    {
+        positionX[id] = position.x;
+        positionY[id] = position.y;
+        positionZ[id] = position.z;
+        rotationX[id] = rotation.x;
+        rotationY[id] = rotation.y;
+        rotationZ[id] = rotation.z;
+        rotationW[id] = rotation.w;
+        scaleX[id] = scale.x;
+        scaleY[id] = scale.y;
+        scaleZ[id] = scale.z;
+        dirty[id / TRANSFORM_BATCH] = 1;
+    }
+
+    // composes the matrices of every dirty batch, large updates are split into jobs
+    void Update()
+    {
+        dirtyBatches.clear();
+        for (unsigned int batch = 0; batch < dirty.size(); batch++)
+            if (dirty[batch])
+                dirtyBatches.push_back(batch);
+        Recomposed = (unsigned int)dirtyBatches.size() * TRANSFORM_BATCH;
+
+        jobSystem.ParallelFor((unsigned int)dirtyBatches.size(), TRANSFORM_JOB_GRAIN, [this](unsigned int begin, unsigned int end) {
+            for (unsigned int i = begin; i < end; i++)
+            {
+                Compose(dirtyBatches[i] * TRANSFORM_BATCH);
+                dirty[dirtyBatches[i]] = 0;
+            }
+        });
+    }
+
+    const glm::mat4& Model(unsigned int id) const
+    {
+        return models[id];
+    }
+
+    const glm::mat3& Normal(unsigned int id) const
+    {
+        return normals[id];
+    }
+
+    unsigned int Size() const
+    {
+        return count;
+    }
+
+private:
+    unsigned int count = 0;
+    vector<float> positionX, positionY, positionZ;
+    vector<float> rotationX, rotationY, rotationZ, rotationW;
+    vector<float> scaleX, scaleY, scaleZ;
+    vector<unsigned char> dirty; // per batch, bytes so jobs can clear them independently
+    vector<unsigned int> dirtyBatches;
+    vector<glm::mat4> models;
+    vector<glm::mat3> normals;
+
+    // arrays always hold whole batches, unused lanes are identity transforms
+    void Grow()
+    {
+        vector<float>* zeros[] = { &positionX, &positionY, &positionZ, &rotationX, &rotationY, &rotationZ };
+        for (vector<float>* values : zeros)
+            values->resize(values->size() + TRANSFORM_BATCH, 0.0f);
+        vector<float>* ones[] = { &rotationW, &scaleX, &scaleY, &scaleZ };
+        for (vector<float>* values : ones)
+            values->resize(values->size() + TRANSFORM_BATCH, 1.0f);
+        dirty.push_back(1);
+        models.resize(models.size() + TRANSFORM_BATCH);
+        normals.resize(normals.size() + TRANSFORM_BATCH);
+    }
+
+    void Compose(unsigned int first)
+    {
+        __m128 qx = _mm_loadu_ps(&rotationX[first]), qy = _mm_loadu_ps(&rotationY[first]);
+        __m128 qz = _mm_loadu_ps(&rotationZ[first]), qw = _mm_loadu_ps(&rotationW[first]);
+        __m128 sx = _mm_loadu_ps(&scaleX[first]), sy = _mm_loadu_ps(&scaleY[first]), sz = _mm_loadu_ps(&scaleZ[first]);
+        __m128 one = _mm_set1_ps(1.0f), two = _mm_set1_ps(2.0f), zero = _mm_setzero_ps();
+
+        // rotation matrix of a unit quaternion, column major like glm::mat3_cast
+        __m128 xx = _mm_mul_ps(qx, qx), yy = _mm_mul_ps(qy, qy), zz = _mm_mul_ps(qz, qz);
+        __m128 xy = _mm_mul_ps(qx, qy), xz = _mm_mul_ps(qx, qz), yz = _mm_mul_ps(qy, qz);
+        __m128 wx = _mm_mul_ps(qw, qx), wy = _mm_mul_ps(qw, qy), wz = _mm_mul_ps(qw, qz);
+        __m128 rotation[3][3] = {
+            { _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), _mm_mul_ps(two, _mm_add_ps(xy, wz)), _mm_mul_ps(two, _mm_sub_ps(xz, wy)) },
+            { _mm_mul_ps(two, _mm_sub_ps(xy, wz)), _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), _mm_mul_ps(two, _mm_add_ps(yz, wx)) },
+            { _mm_mul_ps(two, _mm_add_ps(xz, wy)), _mm_mul_ps(two, _mm_sub_ps(yz, wx)), _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))) }
+        };
+        __m128 scale[3] = { sx, sy, sz };
+
+        for (int column = 0; column < 3; column++)
+        {
+            __m128 inverseScale = _mm_div_ps(one, scale[column]);
+            __m128 m0 = _mm_mul_ps(rotation[column][0], scale[column]);
+            __m128 m1 = _mm_mul_ps(rotation[column][1], scale[column]);
+            __m128 m2 = _mm_mul_ps(rotation[column][2], scale[column]);
+            __m128 m3 = zero;
+            __m128 n0 = _mm_mul_ps(rotation[column][0], inverseScale);
+            __m128 n1 = _mm_mul_ps(rotation[column][1], inverseScale);
+            __m128 n2 = _mm_mul_ps(rotation[column][2], inverseScale);
+            __m128 n3 = zero;
+            // lanes hold one transform each, the transpose gives one matrix column per transform
+            _MM_TRANSPOSE4_PS(m0, m1, m2, m3);
+            _MM_TRANSPOSE4_PS(n0, n1, n2, n3);
+            __m128 modelColumns[4] = { m0, m1, m2, m3 };
+            __m128 normalColumns[4] = { n0, n1, n2, n3 };
+            for (unsigned int lane = 0; lane < TRANSFORM_BATCH; lane++)
+            {
+                _mm_storeu_ps(&models[first + lane][column][0], modelColumns[lane]);
+                float normal[4];
+                _mm_storeu_ps(normal, normalColumns[lane]);
+                std::memcpy(&normals[first + lane][column][0], normal, 3 * sizeof(float));
+            }
+        }
+
+        __m128 px = _mm_loadu_ps(&positionX[first]), py = _mm_loadu_ps(&positionY[first]);
+        __m128 pz = _mm_loadu_ps(&positionZ[first]), pw = one;
+        _MM_TRANSPOSE4_PS(px, py, pz, pw);
+        __m128 translations[4] = { px, py, pz, pw };
+        for (unsigned int lane = 0; lane < TRANSFORM_BATCH; lane++)
+            _mm_storeu_ps(&models[first + lane][3][0], translations[lane]);
+    }
+};
+
+TransformStore transformStore;
+#endif
@@ -0,0 +1,134 @@
+#version 330 core
+out vec4 FragColor;
+
+struct Light {
+    int type;
+
+    vec3 position;
+    vec3 direction;
+    float cutOff;
+    float outerCutOff;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+in vec3 FragPos;
+in vec3 Normal;
+in vec2 TexCoords;
+
+#include "lighting.glsl"
+
+#ifdef INSTANCED
+flat in float InstanceFade;
+#include "dither.glsl"
+#endif
+
+// light data, six texels per light, see ClusteredLighting::PackLight
+uniform samplerBuffer clusterLights;
+// offset and count into clusterIndices per cluster
+uniform usamplerBuffer clusterGrid;
+uniform usamplerBuffer clusterIndices;
+
+uniform vec3 clusterGridSize;
+uniform vec2 screenSize;
+uniform float nearPlane;
+uniform float farPlane;
+
+int CalcClusterIndex();
+Light FetchLight(int index);
+vec3 CalcLight(Light light, vec3 albedo, vec3 norm, vec3 viewDir);
+
+void main()
+{
+#ifdef INSTANCED
+    // the hall board leaves these pixels to its impostor while it fades over
+    if (DitherThreshold() < InstanceFade)
+        discard;
+#endif
+    vec3 albedo = texture(material.diffuse, TexCoords).rgb;
+    vec3 norm = normalize(Normal);
+    vec3 viewDir = normalize(viewPos - FragPos);
+
+    uvec2 cluster = texelFetch(clusterGrid, CalcClusterIndex()).rg;
+    vec3 result = vec3(0.0);
+    for (uint i = 0u; i < cluster.y; i++)
+    {
+        int lightIndex = int(texelFetch(clusterIndices, int(cluster.x + i)).r);
+        result += CalcLight(FetchLight(lightIndex), albedo, norm, viewDir);
+    }
+
+    FragColor = vec4(result, 1.0);
+}
+
+// same grid as ClusteredLighting: screen tiles and exponential slices of the view depth
+int CalcClusterIndex()
+{
+    float ndcDepth = gl_FragCoord.z * 2.0 - 1.0;
+    float viewDepth = 2.0 * nearPlane * farPlane / (farPlane + nearPlane - ndcDepth * (farPlane - nearPlane));
+    int slice = int(log(viewDepth / nearPlane) / log(farPlane / nearPlane) * clusterGridSize.z);
+
+    ivec3 gridSize = ivec3(clusterGridSize);
+    ivec2 tile = ivec2(gl_FragCoord.xy / screenSize * clusterGridSize.xy);
+    tile = clamp(tile, ivec2(0), gridSize.xy - 1);
+    slice = clamp(slice, 0, gridSize.z - 1);
+    return tile.x + gridSize.x * (tile.y + gridSize.y * slice);
+}
+
+Light FetchLight(int index)
+{
+    int base = index * 6;
+    vec4 positionType = texelFetch(clusterLights, base);
+    vec4 directionCutOff = texelFetch(clusterLights, base + 1);
+    vec4 ambientOuterCutOff = texelFetch(clusterLights, base + 2);
+    vec4 attenuation = texelFetch(clusterLights, base + 5);
+
+    Light light;
+    light.type = int(positionType.w);
+    light.position = positionType.xyz;
+    light.direction = directionCutOff.xyz;
+    light.cutOff = directionCutOff.w;
+    light.outerCutOff = ambientOuterCutOff.w;
+    light.ambient = ambientOuterCutOff.rgb;
+    light.diffuse = texelFetch(clusterLights, base + 3).rgb;
+    light.specular = texelFetch(clusterLights, base + 4).rgb;
+    light.constant = attenuation.x;
+    light.linear = attenuation.y;
+    light.quadratic = attenuation.z;
+    return light;
+}
+
+vec3 CalcLight(Light light, vec3 albedo, vec3 norm, vec3 viewDir)
+{
+    float distance    = length(light.position - FragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+
+    // ambient
+    vec3 ambient = light.ambient * albedo;
+
+    // diffuse
+    vec3 lightDir = normalize(light.position - FragPos);
+    float diff = max(dot(norm, lightDir), 0.0);
+    vec3 diffuse = light.diffuse * diff * albedo;
+
+    // specular
+    float spec = CalcSpecular(norm, lightDir, viewDir);
+    vec3 specular = light.specular * (spec * material.specular);
+
+    // spotlight (smooth edges)
+    if (light.type == 1)
+    {
+        float theta = dot(lightDir, -light.direction);
+        float epsilon = (light.cutOff - light.outerCutOff);
+        float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+        diffuse  *= intensity;
+        specular *= intensity;
+    }
+
+    return (ambient + diffuse + specular) * attenuation;
+}
\ No newline at end of file
@@ -0,0 +1,14 @@
+#version 330 core
+out vec4 FragColor;
+
+uniform sampler2D gDepth;
+
+// geometry pixels start from black, the light volumes are added on top of it,
+// the background keeps the clear color, the scene covers the lower left part of the G-buffer
+void main()
+{
+    float depth = texelFetch(gDepth, ivec2(gl_FragCoord.xy), 0).r;
+    if (depth == 1.0) discard;
+
+    FragColor = vec4(0.0, 0.0, 0.0, 1.0);
+}
\ No newline at end of file
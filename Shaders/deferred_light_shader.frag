@@ -0,0 +1,93 @@
+#version 330 core
+out vec4 FragColor;
+
+struct Light {
+    int type;
+
+    vec3 position;
+    vec3 direction;
+    float cutOff;
+    float outerCutOff;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+
+    float constant;
+    float linear;
+    float quadratic;
+
+    float intensity;
+};
+
+uniform sampler2D gAlbedoSpec;
+uniform sampler2D gNormal;
+uniform sampler2D gDepth;
+
+uniform vec2 screenSize;
+uniform mat4 inverseViewProjection;
+uniform vec3 viewPos;
+uniform bool useBlinn;
+uniform Light light;
+
+vec3 ReconstructPosition(vec2 uv, float depth);
+
+void main()
+{
+    // the G-buffer can be larger than the scene, the scene covers its lower left part
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gDepth, texel, 0).r;
+    if (depth == 1.0) discard;
+
+    vec3 fragPos = ReconstructPosition(gl_FragCoord.xy / screenSize, depth);
+    vec4 albedoSpec = texelFetch(gAlbedoSpec, texel, 0);
+    vec3 albedo = albedoSpec.rgb;
+    vec3 norm = normalize(texelFetch(gNormal, texel, 0).xyz);
+
+    float distance    = length(light.position - fragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+
+    // ambient
+    vec3 ambient = light.ambient * albedo;
+
+    // diffuse
+    vec3 lightDir = normalize(light.position - fragPos);
+    float diff = max(dot(norm, lightDir), 0.0);
+    vec3 diffuse = light.intensity * light.diffuse * diff * albedo;
+
+    // specular
+    vec3 viewDir = normalize(viewPos - fragPos);
+    float spec = 0.0;
+    if(useBlinn)
+    {
+        vec3 halfwayDir = normalize(lightDir + viewDir);
+        spec = pow(max(dot(norm, halfwayDir), 0.0), 32.0);
+    }
+    else
+    {
+        vec3 reflectDir = reflect(-lightDir, norm);
+        spec = pow(max(dot(viewDir, reflectDir), 0.0), 8.0);
+    }
+    vec3 specular = light.intensity * light.specular * spec * albedoSpec.a;
+
+    // spotlight (smooth edges)
+    if (light.type == 1)
+    {
+        float theta = dot(lightDir, normalize(-light.direction));
+        float epsilon = (light.cutOff - light.outerCutOff);
+        float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+        diffuse  *= intensity;
+        specular *= intensity;
+    }
+
+    vec3 result = (ambient + diffuse + specular) * attenuation;
+
+    FragColor = vec4(result, 1.0);
+}
+
+vec3 ReconstructPosition(vec2 uv, float depth)
+{
+    vec4 ndc = vec4(uv * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+    vec4 world = inverseViewProjection * ndc;
+    return world.xyz / world.w;
+}
\ No newline at end of file
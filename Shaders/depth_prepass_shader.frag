@@ -0,0 +1,15 @@
+#version 330 core
+
+#ifdef INSTANCED
+flat in float InstanceFade;
+#include "dither.glsl"
+#endif
+
+void main()
+{
+#ifdef INSTANCED
+    // the hall board leaves these pixels to its impostor while it fades over
+    if (DitherThreshold() < InstanceFade)
+        discard;
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,22 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+#include "draw_data.glsl"
+
+uniform mat4 view;
+uniform mat4 projection;
+
+invariant gl_Position;
+
+#ifdef INSTANCED
+flat out float InstanceFade;
+#endif
+
+void main()
+{
+    vec4 worldPos = DrawWorldPosition(aPos);
+    gl_Position = projection * view * worldPos;
+#ifdef INSTANCED
+    InstanceFade = DrawInstanceFade();
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,16 @@
+// Screen-door crossfade between a hall board and its impostor, pulled in with #include by the Shader
+// preprocessor. A 4x4 ordered dither gives every pixel a threshold, the impostor keeps the pixels
+// below its fade and the board all others, so the two never blend and need no sorting.
+
+const float DITHER_BAYER[16] = float[16](
+     0.0,  8.0,  2.0, 10.0,
+    12.0,  4.0, 14.0,  6.0,
+     3.0, 11.0,  1.0,  9.0,
+    15.0,  7.0, 13.0,  5.0
+);
+
+float DitherThreshold()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy) & 3;
+    return (DITHER_BAYER[pixel.y * 4 + pixel.x] + 0.5) / 16.0;
+}
\ No newline at end of file
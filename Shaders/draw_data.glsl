@@ -0,0 +1,39 @@
+// Per draw data of the render queue, pulled in with #include by the Shader preprocessor. The queue
+// writes one block per draw into a streamed uniform buffer and binds its range before the draw,
+// the layout has to match DrawData in renderqueue.h. Instanced variants draw the same mesh once per
+// offset of the InstanceData block, the offsets only translate (the boards of the tournament hall)
+// and their w is the fade to the impostor.
+
+layout(std140) uniform DrawData {
+    mat4 model;
+    // inverse transpose of the model matrix, computed once per object on the CPU
+    mat3 normalMatrix;
+    // emissive draws share one program, their brightness is set per draw
+    float brightnessLevel;
+};
+
+#define INSTANCE_BATCH 1024
+
+#ifdef INSTANCED
+layout(std140) uniform InstanceData {
+    vec4 instanceOffsets[INSTANCE_BATCH];
+};
+#endif
+
+// every vertex shader places its vertex through this, so all of them agree on the position
+vec4 DrawWorldPosition(vec3 position)
+{
+    vec4 worldPos = model * vec4(position, 1.0);
+#ifdef INSTANCED
+    worldPos.xyz += instanceOffsets[gl_InstanceID].xyz;
+#endif
+    return worldPos;
+}
+
+#ifdef INSTANCED
+// share of the instance already faded over to its impostor, 0 draws it whole
+float DrawInstanceFade()
+{
+    return instanceOffsets[gl_InstanceID].w;
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,12 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D diffuseTexture;
+
+// unlit stand-in, drawn while the real lighting programs are still compiling
+void main()
+{
+    FragColor = vec4(0.6 * texture(diffuseTexture, TexCoords).rgb, 1.0);
+}
\ No newline at end of file
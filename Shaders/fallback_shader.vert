@@ -0,0 +1,20 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 2) in vec2 aTexCoords;
+
+out vec2 TexCoords;
+
+#include "draw_data.glsl"
+
+uniform mat4 view;
+uniform mat4 projection;
+
+// must match the depth pre-pass bit for bit, it is followed by GL_EQUAL depth testing
+invariant gl_Position;
+
+void main()
+{
+    vec4 worldPos = DrawWorldPosition(aPos);
+    TexCoords = aTexCoords;
+    gl_Position = projection * view * worldPos;
+}
\ No newline at end of file
@@ -0,0 +1,46 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D sceneTexture;
+uniform sampler2D depthTexture;
+
+uniform mat4 inverseViewProjection;
+uniform vec2 sourceSize;
+uniform vec3 viewPos;
+uniform float fogLevel;
+
+const vec3 FOG_COLOR = vec3(0.05);
+
+float CalcFogFactor(vec3 fragPos);
+
+// fades every pixel towards the fog color by its distance to the camera, reconstructed from the
+// depth buffer, so each pixel is fogged once whatever was drawn over it
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec3 color = texelFetch(sceneTexture, pixel, 0).rgb;
+    float depth = texelFetch(depthTexture, pixel, 0).r;
+    if (depth == 1.0)
+    {
+        FragColor = vec4(color, 1.0);
+        return;
+    }
+
+    vec2 uv = gl_FragCoord.xy / sourceSize;
+    vec4 world = inverseViewProjection * vec4(uv * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+    vec3 fragPos = world.xyz / world.w;
+
+    FragColor = vec4(mix(FOG_COLOR, color, CalcFogFactor(fragPos)), 1.0);
+}
+
+float CalcFogFactor(vec3 fragPos) {
+    float gradient = (fogLevel * fogLevel - 7 * fogLevel + 28) / 2;
+    float distance = length(viewPos - fragPos);
+
+    float fogFactor = exp(-pow((distance / gradient), 5)) ;
+
+    fogFactor = clamp(fogFactor, 0.0, 1.0);
+    return fogFactor;
+}
\ No newline at end of file
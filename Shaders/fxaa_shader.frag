@@ -0,0 +1,57 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D sceneTexture;
+uniform vec2 sourceSize;  // pixels of the texture the scene was drawn into
+uniform vec2 textureSize; // pixels of the whole texture
+
+const float EDGE_THRESHOLD     = 0.125;
+const float EDGE_THRESHOLD_MIN = 0.0312;
+const float SPAN_MAX           = 8.0;
+const float REDUCE_MUL         = 1.0 / 8.0;
+const float REDUCE_MIN         = 1.0 / 128.0;
+
+float Luma(vec3 color)
+{
+    return dot(color, vec3(0.299, 0.587, 0.114));
+}
+
+vec3 SampleScene(vec2 pixel)
+{
+    return texture(sceneTexture, clamp(pixel, vec2(0.5), sourceSize - 0.5) / textureSize).rgb;
+}
+
+// FXAA: finds edges from the luma contrast of the diagonal neighbors and blends along them with
+// bilinear taps, pixels without enough contrast are copied after five fetches
+void main()
+{
+    vec2 pixel = gl_FragCoord.xy;
+    vec3 colorM = SampleScene(pixel);
+    float lumaM  = Luma(colorM);
+    float lumaNW = Luma(SampleScene(pixel + vec2(-1.0,  1.0)));
+    float lumaNE = Luma(SampleScene(pixel + vec2( 1.0,  1.0)));
+    float lumaSW = Luma(SampleScene(pixel + vec2(-1.0, -1.0)));
+    float lumaSE = Luma(SampleScene(pixel + vec2( 1.0, -1.0)));
+
+    float lumaMin = min(lumaM, min(min(lumaNW, lumaNE), min(lumaSW, lumaSE)));
+    float lumaMax = max(lumaM, max(max(lumaNW, lumaNE), max(lumaSW, lumaSE)));
+    if (lumaMax - lumaMin < max(EDGE_THRESHOLD_MIN, lumaMax * EDGE_THRESHOLD))
+    {
+        FragColor = vec4(colorM, 1.0);
+        return;
+    }
+
+    // direction along the edge, perpendicular to the luma gradient
+    vec2 direction = vec2((lumaNW + lumaNE) - (lumaSW + lumaSE), (lumaNW + lumaSW) - (lumaNE + lumaSE));
+    float directionReduce = max((lumaNW + lumaNE + lumaSW + lumaSE) * 0.25 * REDUCE_MUL, REDUCE_MIN);
+    float inverseDirectionMin = 1.0 / (min(abs(direction.x), abs(direction.y)) + directionReduce);
+    direction = clamp(direction * inverseDirectionMin, vec2(-SPAN_MAX), vec2(SPAN_MAX));
+
+    vec3 colorA = 0.5 * (SampleScene(pixel + direction * (1.0 / 3.0 - 0.5)) + SampleScene(pixel + direction * (2.0 / 3.0 - 0.5)));
+    vec3 colorB = colorA * 0.5 + 0.25 * (SampleScene(pixel - direction * 0.5) + SampleScene(pixel + direction * 0.5));
+    // the wide blend overshoots where the span left the edge, the narrow one is used there
+    float lumaB = Luma(colorB);
+    FragColor = vec4((lumaB < lumaMin || lumaB > lumaMax) ? colorA : colorB, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,32 @@
+#version 330 core
+layout (location = 0) out vec4 gAlbedoSpec;
+layout (location = 1) out vec4 gNormal;
+
+struct Material {
+    sampler2D diffuse;
+    vec3 specular;
+    float shininess;
+};
+
+in vec3 FragPos;
+in vec3 Normal;
+in vec2 TexCoords;
+
+uniform Material material;
+
+#ifdef INSTANCED
+flat in float InstanceFade;
+#include "dither.glsl"
+#endif
+
+void main()
+{
+#ifdef INSTANCED
+    // the hall board leaves these pixels to its impostor while it fades over
+    if (DitherThreshold() < InstanceFade)
+        discard;
+#endif
+    // materials use a grey specular color, a single channel is enough
+    gAlbedoSpec = vec4(texture(material.diffuse, TexCoords).rgb, material.specular.r);
+    gNormal = vec4(normalize(Normal), 0.0);
+}
\ No newline at end of file
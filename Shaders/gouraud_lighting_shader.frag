@@ -3,7 +3,17 @@
 in vec4 fragColor;
 out vec4 FragColor;
 
+#ifdef INSTANCED
+flat in float InstanceFade;
+#include "dither.glsl"
+#endif
+
 void main()
 {
+#ifdef INSTANCED
+    // the hall board leaves these pixels to its impostor while it fades over
+    if (DitherThreshold() < InstanceFade)
+        discard;
+#endif
 	FragColor = fragColor;
 }
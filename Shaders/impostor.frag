@@ -0,0 +1,29 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec3 FragPos;
+in vec2 AtlasCoords;
+flat in float InstanceFade;
+
+#include "lighting.glsl"
+#include "dither.glsl"
+
+uniform sampler2D impostorAlbedo;
+uniform sampler2D impostorNormal;
+
+void main()
+{
+    vec4 albedo = texture(impostorAlbedo, AtlasCoords);
+    // outside the silhouette, or a pixel the board still draws itself while fading over
+    if (albedo.a < 0.5 || DitherThreshold() >= InstanceFade)
+        discard;
+    vec3 normal = texture(impostorNormal, AtlasCoords).rgb * 2.0 - 1.0;
+
+    // lit at the quad instead of the surface, the difference vanishes with the distance
+    vec3 result = CalcLampLight(albedo.rgb, FragPos, normal, 1.0);
+#ifdef SPOTLIGHT_ON
+    result += CalcSpotlightLight(albedo.rgb, FragPos, normal, 1.0);
+#endif
+
+    FragColor = vec4(result, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#version 330 core
+
+// one camera-facing quad per distant hall board, its offset and fade come from the InstanceData block
+#define INSTANCED
+#include "draw_data.glsl"
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec3 viewPos;
+
+// bounding sphere the atlas was captured around and the frames along each side of the atlas
+uniform vec3 impostorCenter;
+uniform float impostorRadius;
+uniform float impostorFrames;
+
+out vec3 FragPos;
+out vec2 AtlasCoords;
+flat out float InstanceFade;
+
+// hemi-octahedral mapping of the upper hemisphere onto the unit square, as in Impostor::FrameDirection
+vec2 HemiOctEncode(vec3 direction)
+{
+    vec2 p = direction.xz / (abs(direction.x) + abs(direction.y) + abs(direction.z));
+    return vec2(p.x + p.y, p.x - p.y) * 0.5 + 0.5;
+}
+
+vec3 HemiOctDecode(vec2 coords)
+{
+    vec2 t = coords * 2.0 - 1.0;
+    vec2 p = vec2(t.x + t.y, t.x - t.y) * 0.5;
+    return normalize(vec3(p.x, 1.0 - abs(p.x) - abs(p.y), p.y));
+}
+
+void main()
+{
+    vec3 center = impostorCenter + instanceOffsets[gl_InstanceID].xyz;
+
+    // the frame captured nearest to the view direction, from below the horizon the lowest ones
+    vec3 toView = viewPos - center;
+    toView.y = max(toView.y, 0.0);
+    vec2 frame = clamp(floor(HemiOctEncode(normalize(toView)) * impostorFrames), 0.0, impostorFrames - 1.0);
+    vec3 direction = HemiOctDecode((frame + 0.5) / impostorFrames);
+
+    // the quad lies in the image plane of that frame, so the frame maps onto it unchanged
+    vec3 up = abs(direction.y) > 0.999 ? vec3(0.0, 0.0, -1.0) : vec3(0.0, 1.0, 0.0);
+    vec3 right = normalize(cross(up, direction));
+    up = cross(direction, right);
+
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+    FragPos = center + (right * (corner.x * 2.0 - 1.0) + up * (corner.y * 2.0 - 1.0)) * impostorRadius;
+    AtlasCoords = (frame + corner) / impostorFrames;
+    InstanceFade = DrawInstanceFade();
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
\ No newline at end of file
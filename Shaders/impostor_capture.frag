@@ -0,0 +1,15 @@
+#version 330 core
+layout (location = 0) out vec4 Albedo;
+layout (location = 1) out vec4 WorldNormal;
+
+in vec3 Normal;
+in vec2 TexCoords;
+
+uniform sampler2D texture_diffuse1;
+
+// unlit, the impostor is lit when it is drawn, the alpha marks the pixels the geometry covers
+void main()
+{
+    Albedo = vec4(texture(texture_diffuse1, TexCoords).rgb, 1.0);
+    WorldNormal = vec4(normalize(Normal) * 0.5 + 0.5, 1.0);
+}
\ No newline at end of file
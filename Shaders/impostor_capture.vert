@@ -0,0 +1,19 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+
+out vec3 Normal;
+out vec2 TexCoords;
+
+#include "draw_data.glsl"
+
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    Normal = normalMatrix * aNormal;
+    TexCoords = aTexCoords;
+    gl_Position = projection * view * DrawWorldPosition(aPos);
+}
\ No newline at end of file
@@ -3,15 +3,14 @@ layout(location = 0) in vec3 aPos;
 layout(location = 1) in vec2 aTexCoord;
 
 out vec2 TexCoord;
-out vec3 FragPos;
 
-uniform mat4 model;
+#include "draw_data.glsl"
+
 uniform mat4 view;
 uniform mat4 projection;
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0f));
     gl_Position = projection * view * model * vec4(aPos, 1.0f);
     TexCoord = vec2(aTexCoord.x, aTexCoord.y);
 }
\ No newline at end of file
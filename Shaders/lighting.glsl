@@ -0,0 +1,121 @@
+// Lighting library shared by the forward shaders, pulled in with #include by the Shader preprocessor.
+// Switches are compiled in as defines instead of being branched on at runtime:
+//   USE_BLINN     Blinn-Phong specular instead of Phong
+//   SPOTLIGHT_ON  the orbiting spotlight lights the scene
+//   USE_SHADOWS   shadow maps of the lamp and the spotlight (Phong only)
+
+struct Material {
+    sampler2D diffuse;
+    vec3 specular;
+    float shininess;
+};
+
+struct LampLight {
+    vec3 position;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+
+    float constant;
+    float linear;
+    float quadratic;
+
+    float brightnessLevel;
+};
+
+struct SpotlightLight {
+    vec3 position;  
+    vec3 direction;
+    float cutOff;
+    float outerCutOff;
+  
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+	
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+uniform vec3 viewPos;
+uniform Material material;
+uniform LampLight lampLight;
+uniform SpotlightLight spotlightLight;
+
+float CalcSpecular(vec3 norm, vec3 lightDir, vec3 viewDir)
+{
+#ifdef USE_BLINN
+    vec3 halfwayDir = normalize(lightDir + viewDir);  
+    return pow(max(dot(norm, halfwayDir), 0.0), 32.0);
+#else
+    vec3 reflectDir = reflect(-lightDir, norm);
+    return pow(max(dot(viewDir, reflectDir), 0.0), 8.0);
+#endif
+}
+
+// shadow is the lit fraction of the direct light, 1 without shadow maps
+vec3 CalcLampLight(vec3 albedo, vec3 fragPos, vec3 normal, float shadow) 
+{
+    float distance    = length(lampLight.position - fragPos);
+    float attenuation = 1.0 / (lampLight.constant + lampLight.linear * distance + 
+    		            lampLight.quadratic * (distance * distance)); 
+
+    // ambient
+    vec3 ambient = lampLight.ambient * albedo;
+
+    // diffuse 
+    vec3 norm = normalize(normal);
+    vec3 lightDir = normalize(lampLight.position - fragPos);
+    float diff = max(dot(norm, lightDir), 0.0);
+    vec3 diffuse = lampLight.brightnessLevel * lampLight.diffuse * diff * albedo;
+
+    // specular
+    vec3 viewDir = normalize(viewPos - fragPos);
+    float spec = CalcSpecular(norm, lightDir, viewDir);
+    vec3 specular = lampLight.brightnessLevel * lampLight.specular * (spec * material.specular);
+
+    ambient  *= attenuation; 
+    diffuse  *= attenuation * shadow;
+    specular *= attenuation * shadow; 
+
+    return (ambient + diffuse + specular);
+}
+
+vec3 CalcSpotlightLight(vec3 albedo, vec3 fragPos, vec3 normal, float shadow)
+{
+    vec3 lightDir = normalize(spotlightLight.position - fragPos);
+    
+    float theta = dot(lightDir, normalize(-spotlightLight.direction)); 
+      
+    // ambient
+    vec3 ambient = spotlightLight.ambient * albedo;
+        
+    // diffuse 
+    vec3 norm = normalize(normal);
+    float diff = max(dot(norm, lightDir), 0.0);
+    vec3 diffuse = spotlightLight.diffuse * diff * albedo;  
+        
+    // specular
+    vec3 viewDir = normalize(viewPos - fragPos);
+    float spec = CalcSpecular(norm, lightDir, viewDir);
+    vec3 specular = spotlightLight.specular * lampLight.specular * (spec * material.specular);
+        
+    // spotlight (smooth edges)
+    float epsilon = (spotlightLight.cutOff - spotlightLight.outerCutOff);
+    float intensity = clamp((theta - spotlightLight.outerCutOff) / epsilon, 0.0, 1.0);
+    intensity *= shadow;
+    diffuse  *= intensity;
+    specular *= intensity;
+
+    // attenuation
+    float distance    = length(spotlightLight.position - fragPos);
+    float attenuation = 1.0 / (spotlightLight.constant + spotlightLight.linear * distance + spotlightLight.quadratic * (distance * distance));    
+
+    ambient  *= attenuation;
+    diffuse   *= attenuation;
+    specular *= attenuation;   
+            
+    return (ambient + diffuse + specular);
+}
\ No newline at end of file
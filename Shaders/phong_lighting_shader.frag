@@ -1,163 +1,74 @@
 #version 330 core
 out vec4 FragColor;
 
-struct Material {
-    sampler2D diffuse;
-    vec3 specular;
-    float shininess;
-};
-
-struct LampLight {
-    vec3 position;
-
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-
-    float constant;
-    float linear;
-    float quadratic;
-
-    float brightnessLevel;
-};
-
-struct SpotlightLight {
-    bool ON;
-
-    vec3 position;  
-    vec3 direction;
-    float cutOff;
-    float outerCutOff;
-  
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-	
-    float constant;
-    float linear;
-    float quadratic;
-};
-
 in vec3 FragPos;
 in vec3 Normal;
 in vec2 TexCoords;
 
-uniform vec3 viewPos;
-uniform Material material;
-uniform LampLight lampLight;
-uniform SpotlightLight spotlightLight;
-uniform float brightnessLevel;
-uniform bool useBlinn;
-uniform float fogLevel;
+#include "lighting.glsl"
+
+#ifdef INSTANCED
+flat in float InstanceFade;
+#include "dither.glsl"
+#endif
+
+#ifdef USE_SHADOWS
+uniform sampler2DShadow spotlightShadowMap;
+uniform samplerCubeShadow lampShadowMap;
+uniform mat4 spotlightLightSpace;
+uniform float lampShadowFar;
 
-vec3 CalcLampLight(LampLight lampLight, vec3 fragPos, vec3 normal);
-vec3 CalcSpotlightLight(SpotlightLight spotlightLight, vec3 fragPos, vec3 normal);
-float CalcFogFactor();
+float CalcLampShadow(vec3 fragPos);
+float CalcSpotlightShadow(vec3 fragPos);
+#endif
 
 void main()
 {
-    vec3 result = CalcLampLight(lampLight, FragPos, Normal);
-    result += CalcSpotlightLight(spotlightLight, FragPos, Normal);
-
-    float fogFactor = CalcFogFactor();
-   
-    result = mix(vec3(0.05f), result, fogFactor);
+#ifdef INSTANCED
+    // the hall board leaves these pixels to its impostor while it fades over
+    if (DitherThreshold() < InstanceFade)
+        discard;
+#endif
+    vec3 albedo = texture(material.diffuse, TexCoords).rgb;
+
+#ifdef USE_SHADOWS
+    vec3 result = CalcLampLight(albedo, FragPos, Normal, CalcLampShadow(FragPos));
+#else
+    vec3 result = CalcLampLight(albedo, FragPos, Normal, 1.0);
+#endif
+
+#ifdef SPOTLIGHT_ON
+#ifdef USE_SHADOWS
+    result += CalcSpotlightLight(albedo, FragPos, Normal, CalcSpotlightShadow(FragPos));
+#else
+    result += CalcSpotlightLight(albedo, FragPos, Normal, 1.0);
+#endif
+#endif
 
     FragColor = vec4(result, 1.0);
 }
 
-vec3 CalcLampLight(LampLight lampLight, vec3 fragPos, vec3 normal) 
+#ifdef USE_SHADOWS
+// the cube map holds linear distances to the lamp, the bias keeps lit surfaces from shadowing themselves
+float CalcLampShadow(vec3 fragPos)
 {
-    float distance    = length(lampLight.position - fragPos);
-    float attenuation = 1.0 / (lampLight.constant + lampLight.linear * distance + 
-    		            lampLight.quadratic * (distance * distance)); 
-
-    // ambient
-    vec3 ambient = lampLight.ambient * texture(material.diffuse, TexCoords).rgb;
-
-    // diffuse 
-    vec3 norm = normalize(normal);
-    vec3 lightDir = normalize(lampLight.position - fragPos);
-    float diff = max(dot(norm, lightDir), 0.0);
-    vec3 diffuse = lampLight.brightnessLevel * lampLight.diffuse * diff * texture(material.diffuse, TexCoords).rgb;
-
-    // specular
-    vec3 viewDir = normalize(viewPos - fragPos);
-    float spec = 0.0;
-    if(useBlinn)
-    {
-        vec3 halfwayDir = normalize(lightDir + viewDir);  
-        spec = pow(max(dot(norm, halfwayDir), 0.0), 32.0);
-    }
-    else
-    {
-        vec3 reflectDir = reflect(-lightDir, norm);
-        spec = pow(max(dot(viewDir, reflectDir), 0.0), 8.0);
-    }
-    vec3 specular = lampLight.brightnessLevel * lampLight.specular * (spec * material.specular);
-
-    ambient  *= attenuation; 
-    diffuse  *= attenuation;
-    specular *= attenuation; 
-
-    return (ambient + diffuse + specular);
+    vec3 lampToFrag = fragPos - lampLight.position;
+    float depth = length(lampToFrag) / lampShadowFar - 0.0015;
+    return texture(lampShadowMap, vec4(lampToFrag, depth));
 }
 
-float CalcFogFactor() {
-    if (fogLevel == 0) return 1;
-    float gradient = (fogLevel * fogLevel - 7 * fogLevel + 28) / 2;
-    float distance = length(viewPos - FragPos);
-
-    float fogFactor = exp(-pow((distance / gradient), 5)) ;
-
-    fogFactor = clamp(fogFactor, 0.0, 1.0);
-    return fogFactor;
-}
-
-vec3 CalcSpotlightLight(SpotlightLight spotlightLight, vec3 fragPos, vec3 normal)
+// 3x3 percentage closer filtering on top of the bilinear hardware comparison
+float CalcSpotlightShadow(vec3 fragPos)
 {
-    if (spotlightLight.ON == false) return vec3(0);
-
-    vec3 lightDir = normalize(spotlightLight.position - FragPos);
-    
-    float theta = dot(lightDir, normalize(-spotlightLight.direction)); 
-      
-    // ambient
-    vec3 ambient = spotlightLight.ambient * texture(material.diffuse, TexCoords).rgb;
-        
-    // diffuse 
-    vec3 norm = normalize(Normal);
-    float diff = max(dot(norm, lightDir), 0.0);
-    vec3 diffuse = spotlightLight.diffuse * diff * texture(material.diffuse, TexCoords).rgb;  
-        
-    // specular
-    vec3 viewDir = normalize(viewPos - FragPos);
-    float spec = 0.0;
-    if(useBlinn)
-    {
-        vec3 halfwayDir = normalize(lightDir + viewDir);  
-        spec = pow(max(dot(norm, halfwayDir), 0.0), 32.0);
-    }
-    else
-    {
-        vec3 reflectDir = reflect(-lightDir, norm);
-        spec = pow(max(dot(viewDir, reflectDir), 0.0), 8.0);
-    }
-    vec3 specular = spotlightLight.specular * lampLight.specular * (spec * material.specular);
-        
-    // spotlight (smooth edges)
-    float epsilon = (spotlightLight.cutOff - spotlightLight.outerCutOff);
-    float intensity = clamp((theta - spotlightLight.outerCutOff) / epsilon, 0.0, 1.0);
-    diffuse  *= intensity;
-    specular *= intensity;
-
-    // attenuation
-    float distance    = length(spotlightLight.position - FragPos);
-    float attenuation = 1.0 / (spotlightLight.constant + spotlightLight.linear * distance + spotlightLight.quadratic * (distance * distance));    
-
-    ambient  *= attenuation;
-    diffuse   *= attenuation;
-    specular *= attenuation;   
-            
-    return (ambient + diffuse + specular);
-}
\ No newline at end of file
+    vec4 lightSpacePos = spotlightLightSpace * vec4(fragPos, 1.0);
+    vec3 coords = lightSpacePos.xyz / lightSpacePos.w * 0.5 + 0.5;
+    if (coords.z > 1.0) return 1.0;
+
+    vec2 texelSize = 1.0 / vec2(textureSize(spotlightShadowMap, 0));
+    float lit = 0.0;
+    for (int x = -1; x <= 1; x++)
+        for (int y = -1; y <= 1; y++)
+            lit += texture(spotlightShadowMap, vec3(coords.xy + vec2(x, y) * texelSize, coords.z));
+    return lit / 9.0;
+}
+#endif
\ No newline at end of file
@@ -7,14 +7,26 @@ out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoords;
 
-uniform mat4 model;
+#ifdef INSTANCED
+flat out float InstanceFade;
+#endif
+
+#include "draw_data.glsl"
+
 uniform mat4 view;
 uniform mat4 projection;
 
+// must match the depth pre-pass bit for bit, it is followed by GL_EQUAL depth testing
+invariant gl_Position;
+
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;
+    vec4 worldPos = DrawWorldPosition(aPos);
+    FragPos = vec3(worldPos);
+    Normal = normalMatrix * aNormal;
     TexCoords = aTexCoords;    
-    gl_Position = projection * view * vec4(FragPos, 1.0);
+    gl_Position = projection * view * worldPos;
+#ifdef INSTANCED
+    InstanceFade = DrawInstanceFade();
+#endif
 }
\ No newline at end of file
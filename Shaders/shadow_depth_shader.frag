@@ -0,0 +1,11 @@
+#version 330 core
+in vec3 FragPos;
+
+uniform vec3 lightPos;
+uniform float farPlane;
+
+// linear distance to the light, so every cube map face compares the same quantity
+void main()
+{
+    gl_FragDepth = length(FragPos - lightPos) / farPlane;
+}
\ No newline at end of file
@@ -0,0 +1,16 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+out vec3 FragPos;
+
+#include "draw_data.glsl"
+
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    vec4 worldPos = DrawWorldPosition(aPos);
+    FragPos = vec3(worldPos);
+    gl_Position = projection * view * worldPos;
+}
\ No newline at end of file
@@ -0,0 +1,26 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D sceneTexture;
+uniform vec2 sourceSize;  // pixels of the texture the scene was drawn into
+uniform vec2 textureSize; // pixels of the whole texture
+uniform float sharpness;
+
+vec3 SampleScene(vec2 pixel)
+{
+    return texture(sceneTexture, clamp(pixel, vec2(0.5), sourceSize - 0.5) / textureSize).rgb;
+}
+
+// bilinear upscale of the scene to the window, followed by an unsharp mask over the source
+// pixel neighbors that restores the edges the lower resolution and the filtering softened
+void main()
+{
+    vec2 pixel = TexCoords * sourceSize;
+    vec3 center = SampleScene(pixel);
+    vec3 neighbors = SampleScene(pixel + vec2(1.0, 0.0)) + SampleScene(pixel - vec2(1.0, 0.0))
+        + SampleScene(pixel + vec2(0.0, 1.0)) + SampleScene(pixel - vec2(0.0, 1.0));
+
+    FragColor = vec4(clamp(center + sharpness * (center - 0.25 * neighbors), 0.0, 1.0), 1.0);
+}
\ No newline at end of file